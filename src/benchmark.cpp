@@ -0,0 +1,51 @@
+#include "benchmark.h"
+#include "effects.h"
+
+static const int benchmarkSizes[] = {300, 1000, 5000};
+
+void runEffectBenchmark(Print &out)
+{
+  const uint32_t cyclesPerMicro = ESP.getCpuFreqMHz();
+  EffectSettings settings = {CRGB(0x00, 0xFF, 0x00), CRGB(0xFF, 0x00, 0x00)};
+
+  out.printf("Effect benchmark, %d frames, %u MHz\n", BENCHMARK_FRAMES, cyclesPerMicro);
+  out.println("effect          leds   ns/frame  ns/pixel");
+
+  for (int size : benchmarkSizes)
+  {
+    CRGB *buffer = (CRGB *)malloc(sizeof(CRGB) * size);
+    if (buffer == NULL)
+    {
+      out.printf("skipping %d leds, not enough heap\n", size);
+      continue;
+    }
+    fill_solid(buffer, size, CRGB::Black);
+
+    for (uint8_t id = 0; id < EFFECT_COUNT; id++)
+    {
+      EffectState state = {};
+      EffectFrame frame = {buffer, size, (uint32_t)millis(), 50, &state};
+
+      // One warm-up frame so lazily initialised state is not measured
+      renderEffect((EffectId)id, frame, settings);
+
+      uint32_t start = ESP.getCycleCount();
+      for (int i = 0; i < BENCHMARK_FRAMES; i++)
+      {
+        frame.now += frame.elapsed;
+        renderEffect((EffectId)id, frame, settings);
+      }
+      uint32_t cycles = ESP.getCycleCount() - start;
+
+      // Per pixel with fractions, most effects take well under 10 ns a pixel
+      uint64_t nsPerFrame = (uint64_t)cycles * 1000 / cyclesPerMicro / BENCHMARK_FRAMES;
+      double nsPerPixel = (double)cycles * 1000 / cyclesPerMicro / BENCHMARK_FRAMES / size;
+      out.printf("%-14s %5d %10llu %9.2f\n", effectRegistry[id].name, size, (unsigned long long)nsPerFrame,
+                 nsPerPixel);
+
+      vTaskDelay(1); // Let the idle task feed the watchdog
+    }
+
+    free(buffer);
+  }
+}
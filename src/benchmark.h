@@ -0,0 +1,10 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define BENCHMARK_FRAMES 100 // Measured frames per effect and strip size
+
+// Renders every registered effect at several strip lengths into a scratch
+// buffer and prints ns/frame and ns/pixel. Must run on the render task,
+// which owns the effect state.
+void runEffectBenchmark(Print &out);
@@ -0,0 +1,179 @@
+#include "captive_dns.h"
+#include <string.h>
+
+#define DNS_HEADER_SIZE 12
+#define DNS_ANSWER_SIZE 16
+#define DNS_TYPE_A 1
+#define DNS_TYPE_ANY 255
+#define DNS_CLASS_IN 1
+
+// Answer record after the echoed question: name pointer to the question at
+// offset 12, type A, class IN, TTL, address length and the portal address
+static uint8_t answer[DNS_ANSWER_SIZE] = {0xC0, 0x0C, 0, DNS_TYPE_A, 0, DNS_CLASS_IN};
+
+struct CacheEntry
+{
+  uint16_t question; // Question length, 0 if unused
+  uint16_t length;
+  uint8_t response[DNS_HEADER_SIZE + DNS_CACHE_QUESTION + DNS_ANSWER_SIZE];
+};
+static CacheEntry cache[DNS_CACHE_ENTRIES];
+static uint8_t nextCacheEntry = 0;
+
+// Token bucket per client, in thousandths of a query
+struct ClientBucket
+{
+  uint32_t address;
+  uint32_t lastSeen;
+  uint32_t tokens;
+};
+static ClientBucket clients[DNS_MAX_CLIENTS];
+static uint16_t rateLimit = DNS_RATE_LIMIT;
+
+static CaptiveDnsStats stats;
+
+void beginCaptiveDns(const uint8_t ip[4], uint16_t limit)
+{
+  answer[6] = DNS_TTL >> 24;
+  answer[7] = DNS_TTL >> 16;
+  answer[8] = DNS_TTL >> 8;
+  answer[9] = DNS_TTL & 0xFF;
+  answer[10] = 0;
+  answer[11] = 4;
+  memcpy(answer + 12, ip, 4);
+
+  rateLimit = limit;
+  memset(cache, 0, sizeof(cache));
+  memset(clients, 0, sizeof(clients));
+}
+
+static bool allowQuery(uint32_t client, uint32_t now)
+{
+  if (rateLimit == 0)
+    return true;
+
+  // Unknown clients take the least recently seen slot and start with a full burst
+  ClientBucket *bucket = &clients[0];
+  for (uint8_t i = 0; i < DNS_MAX_CLIENTS; i++)
+  {
+    if (clients[i].address == client)
+    {
+      bucket = &clients[i];
+      break;
+    }
+    if (now - clients[i].lastSeen > now - bucket->lastSeen)
+      bucket = &clients[i];
+  }
+  if (bucket->address != client)
+  {
+    bucket->address = client;
+    bucket->tokens = DNS_RATE_BURST * 1000;
+  }
+  else
+  {
+    uint64_t refill = (uint64_t)(now - bucket->lastSeen) * rateLimit;
+    bucket->tokens = refill + bucket->tokens > DNS_RATE_BURST * 1000 ? DNS_RATE_BURST * 1000 : bucket->tokens + refill;
+  }
+  bucket->lastSeen = now;
+
+  if (bucket->tokens < 1000)
+    return false;
+  bucket->tokens -= 1000;
+  return true;
+}
+
+// Returns the length of the question (name, type, class), 0 if malformed
+static size_t questionLength(const uint8_t *query, size_t length)
+{
+  if (length < DNS_HEADER_SIZE)
+    return 0;
+  if ((query[2] & 0xF8) != 0) // A response or an opcode other than QUERY
+    return 0;
+  if (query[4] != 0 || query[5] != 1) // Exactly one question
+    return 0;
+
+  size_t offset = DNS_HEADER_SIZE;
+  while (offset < length && query[offset] != 0)
+  {
+    if (query[offset] & 0xC0) // Compression is not allowed in the only question
+      return 0;
+    offset += query[offset] + 1;
+  }
+  offset += 5; // Root label, type and class
+  if (offset > length || offset - DNS_HEADER_SIZE > 255 + 4)
+    return 0;
+  return offset - DNS_HEADER_SIZE;
+}
+
+size_t answerCaptiveDns(uint32_t client, uint32_t now, const uint8_t *query, size_t length, uint8_t *response)
+{
+  stats.queries++;
+  if (!allowQuery(client, now))
+  {
+    stats.rateLimited++;
+    return 0;
+  }
+
+  size_t question = questionLength(query, length);
+  if (question == 0)
+  {
+    stats.malformed++;
+    return 0;
+  }
+  stats.answered++;
+
+  // Cached responses only differ in the transaction id. The recursion
+  // desired bit is echoed, so it is part of the key.
+  const uint8_t *asked = query + DNS_HEADER_SIZE;
+  for (uint8_t i = 0; i < DNS_CACHE_ENTRIES; i++)
+  {
+    CacheEntry &entry = cache[i];
+    if (entry.question == question && (entry.response[2] & 0x01) == (query[2] & 0x01) &&
+        memcmp(entry.response + DNS_HEADER_SIZE, asked, question) == 0)
+    {
+      stats.cacheHits++;
+      memcpy(response, entry.response, entry.length);
+      response[0] = query[0];
+      response[1] = query[1];
+      return entry.length;
+    }
+  }
+
+  // Only A and ANY get the portal address. Other types, e.g. AAAA, get an
+  // empty answer so clients fall back to IPv4 instead of waiting.
+  uint16_t type = (asked[question - 4] << 8) | asked[question - 3];
+  uint16_t qclass = (asked[question - 2] << 8) | asked[question - 1];
+  bool answered = (type == DNS_TYPE_A || type == DNS_TYPE_ANY) && qclass == DNS_CLASS_IN;
+
+  response[0] = query[0];
+  response[1] = query[1];
+  response[2] = 0x84 | (query[2] & 0x01); // Response, authoritative, RD echoed
+  response[3] = 0x00;                     // No error
+  response[4] = 0;
+  response[5] = 1;
+  response[6] = 0;
+  response[7] = answered ? 1 : 0;
+  memset(response + 8, 0, 4); // No authority or additional records, EDNS is dropped
+  memcpy(response + DNS_HEADER_SIZE, asked, question);
+  size_t size = DNS_HEADER_SIZE + question;
+  if (answered)
+  {
+    memcpy(response + size, answer, DNS_ANSWER_SIZE);
+    size += DNS_ANSWER_SIZE;
+  }
+
+  if (question <= DNS_CACHE_QUESTION)
+  {
+    CacheEntry &entry = cache[nextCacheEntry];
+    nextCacheEntry = (nextCacheEntry + 1) % DNS_CACHE_ENTRIES;
+    memcpy(entry.response, response, size);
+    entry.question = question;
+    entry.length = size;
+  }
+  return size;
+}
+
+const CaptiveDnsStats &captiveDnsStats()
+{
+  return stats;
+}
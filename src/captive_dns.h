@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DNS_PORT 53
+#define DNS_MAX_PACKET 512         // Larger queries are dropped
+#define DNS_MAX_PACKETS_PER_TICK 16 // Bounds the time one scheduler run spends answering
+#define DNS_TTL 60                 // Seconds, short so clients re-ask once provisioned
+#define DNS_CACHE_ENTRIES 8        // Recent questions with a ready-made response
+#define DNS_CACHE_QUESTION 96      // Longest question (name, type, class) that is cached
+#define DNS_MAX_CLIENTS 8          // Clients tracked by the rate limiter
+#define DNS_RATE_LIMIT 20          // Sustained queries per second per client
+#define DNS_RATE_BURST 40          // Queries a client may send at once
+
+// Wildcard DNS for the captive portal: every A query is answered with the
+// portal address. Works on raw packets without any network code, so the
+// caller owns the socket (WiFiUDP on the device, BSD sockets in
+// tools/captive_dns_host.cpp).
+
+struct CaptiveDnsStats
+{
+  uint32_t queries;
+  uint32_t answered;
+  uint32_t cacheHits;
+  uint32_t rateLimited;
+  uint32_t malformed;
+};
+
+// Builds the answer record once. rateLimit is in queries per second per
+// client, 0 turns rate limiting off.
+void beginCaptiveDns(const uint8_t ip[4], uint16_t rateLimit = DNS_RATE_LIMIT);
+
+// Writes the reply to query into response (DNS_MAX_PACKET bytes) and returns
+// its length, or 0 if the packet is dropped. client is the sender's IPv4
+// address, now a millisecond clock.
+size_t answerCaptiveDns(uint32_t client, uint32_t now, const uint8_t *query, size_t length, uint8_t *response);
+
+const CaptiveDnsStats &captiveDnsStats();
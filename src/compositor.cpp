@@ -0,0 +1,76 @@
+#include "compositor.h"
+
+static CRGB *base = NULL;
+
+static const char *overlayNames[OVERLAY_COUNT] = {"none", "degraded", "offline"};
+
+bool beginCompositor(int count)
+{
+  base = (CRGB *)calloc(count, sizeof(CRGB));
+  return base != NULL;
+}
+
+CRGB *baseLayer()
+{
+  return base;
+}
+
+StatusOverlay statusOverlay(bool statusShown, bool internet, bool degraded)
+{
+  if (statusShown)
+    return OVERLAY_NONE;
+  if (!internet)
+    return OVERLAY_OFFLINE;
+  return degraded ? OVERLAY_DEGRADED : OVERLAY_NONE;
+}
+
+const char *statusOverlayName(StatusOverlay overlay)
+{
+  return overlay < OVERLAY_COUNT ? overlayNames[overlay] : "?";
+}
+
+void blendSpan(CRGB *pixels, int count, const CRGB &color, uint8_t alpha)
+{
+  // The color's share is the same for every pixel, only the base is scaled per byte
+  const uint8_t keep = 255 - alpha;
+  const uint8_t r = scale8(color.r, alpha);
+  const uint8_t g = scale8(color.g, alpha);
+  const uint8_t b = scale8(color.b, alpha);
+  uint8_t *bytes = (uint8_t *)pixels;
+  for (int i = 0; i < count; i++, bytes += 3)
+  {
+    bytes[0] = qadd8(scale8(bytes[0], keep), r);
+    bytes[1] = qadd8(scale8(bytes[1], keep), g);
+    bytes[2] = qadd8(scale8(bytes[2], keep), b);
+  }
+}
+
+// Pulse at the strip end, alpha ramping up towards the last pixel
+static void drawEndPulse(CRGB *out, int count, const CRGB &color, uint8_t peak)
+{
+  int length = min(count, OVERLAY_SEGMENT_LENGTH);
+  CRGB *segment = out + count - length;
+  for (int i = 0; i < length; i++)
+  {
+    blendSpan(segment + i, 1, color, peak * (i + 1) / length);
+  }
+}
+
+void composeFrame(CRGB *out, int count, StatusOverlay overlay, uint32_t now)
+{
+  memcpy(out, base, sizeof(CRGB) * count);
+
+  uint8_t wave = triwave8((uint64_t)now * 256 / 1000); // One pulse per second
+  switch (overlay)
+  {
+  case OVERLAY_DEGRADED:
+    drawEndPulse(out, count, CRGB(255, 150, 0), 96 + scale8(wave, 159));
+    break;
+  case OVERLAY_OFFLINE:
+    blendSpan(out, count, CRGB::Red, 32 + scale8(wave, 64));
+    drawEndPulse(out, count, CRGB::Red, 96 + scale8(wave, 159));
+    break;
+  default:
+    break;
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <FastLED.h>
+#include "effects.h"
+
+#define OVERLAY_SEGMENT_LENGTH 12 // Status pip at the end of the strip, in pixels
+
+// Status layer drawn over a user-selected effect
+enum StatusOverlay : uint8_t
+{
+  OVERLAY_NONE,
+  OVERLAY_DEGRADED, // Amber pulse at the strip end
+  OVERLAY_OFFLINE,  // Red tint over the strip and a red pulse at the end
+  OVERLAY_COUNT
+};
+
+// Allocates the base layer effects draw into. It keeps its content between
+// frames, so fading effects keep working while the overlay changes on top.
+bool beginCompositor(int count);
+CRGB *baseLayer();
+
+// Overlay to show on top of the base layer. statusShown is set when a
+// segment already runs a status effect, which then gets no overlay.
+StatusOverlay statusOverlay(bool statusShown, bool internet, bool degraded);
+const char *statusOverlayName(StatusOverlay overlay);
+
+// Blends color over count pixels with one alpha, out = base * (255 - a) + color * a.
+// Per byte scale and saturating add, so the loop maps onto 8-bit SIMD lanes.
+void blendSpan(CRGB *pixels, int count, const CRGB &color, uint8_t alpha);
+
+// Writes base layer plus overlay into out. With no overlay this is a copy.
+void composeFrame(CRGB *out, int count, StatusOverlay overlay, uint32_t now);
@@ -0,0 +1,189 @@
+#include "effects.h"
+#include "timeline.h"
+
+// Lookup tables, so the per-pixel work is a table read instead of an HSV conversion
+static CRGB rainbowLut[256];     // CHSV(h, 255, 255)
+static CRGB fillRainbowLut[256]; // CHSV(h, 240, 255), as fill_rainbow() uses
+static CRGB waitingLut[256];     // CHSV(h, 200, 255)
+static uint8_t waveLut[256];     // Waiting brightness wave over one period, with the HSV value curve applied
+static bool lookupTablesReady = false;
+
+static void buildLookupTables();
+static void effectRainbow(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+static void effectFillRainbow(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+static void effectStatic(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+static void effectSnake(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+static void effectWaiting(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+static void effectBreathe(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+static void effectBlink(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+
+// Indexed by EffectId
+const EffectDescriptor effectRegistry[EFFECT_COUNT] = {
+    {"rainbow", "Rainbow (HSV)", effectRainbow, {0, 2, 0}, EFFECT_MENU_SETUP | EFFECT_MENU_MONITORING},
+    {"fill_rainbow", "Rainbow (Fill)", effectFillRainbow, {0, 2, 0}, EFFECT_MENU_SETUP | EFFECT_MENU_MONITORING},
+    {"static", "Static Color", effectStatic, {0, 0, 0}, EFFECT_MENU_SETUP | EFFECT_MENU_MONITORING | EFFECT_STILL},
+    {"snake", "Snake", effectSnake, {0, 1, 0}, EFFECT_MENU_SETUP | EFFECT_MENU_MONITORING},
+    {"waiting", "Waiting", effectWaiting, {0, 1, 0}, EFFECT_MENU_SETUP},
+    {"breathe_green", "Breathe Green", effectBreathe, {96, 3, 0}, EFFECT_STATUS},
+    {"blink_red", "Blink Red", effectBlink, {0, 0, 250}, EFFECT_STATUS},
+    {"breathe_amber", "Breathe Amber", effectBreathe, {40, 3, 0}, EFFECT_STATUS},
+    {"timeline", "Timeline", renderTimeline, {0, 0, 0}, EFFECT_MENU_SETUP | EFFECT_MENU_MONITORING},
+    {"checking", "Checking", effectBreathe, {160, 2, 0}, EFFECT_STATUS},
+};
+
+EffectId findEffect(const char *name)
+{
+  for (uint8_t i = 0; i < EFFECT_COUNT; i++)
+  {
+    if (strcmp(effectRegistry[i].name, name) == 0)
+    {
+      return (EffectId)i;
+    }
+  }
+  return EFFECT_NONE;
+}
+
+bool parseHexColor(const char *text, CRGB &color)
+{
+  if (text[0] != '#' || strlen(text) != 7)
+    return false;
+  for (int i = 1; i < 7; i++)
+  {
+    if (!isxdigit((unsigned char)text[i]))
+      return false;
+  }
+
+  long value = strtol(text + 1, NULL, 16);
+
+  color = CRGB((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF);
+  return true;
+}
+
+void formatHexColor(const CRGB &color, char *text)
+{
+  snprintf(text, 8, "#%02X%02X%02X", color.r, color.g, color.b);
+}
+
+EffectId statusEffect(EffectId current, bool internet, bool degraded)
+{
+  if (!(effectRegistry[current].flags & EFFECT_STATUS))
+    return current; // User picked an effect, leave it alone
+  if (!internet)
+    return EFFECT_BLINK_RED;
+  return degraded ? EFFECT_BREATHE_AMBER : EFFECT_BREATHE_GREEN;
+}
+
+void renderEffect(EffectId id, const EffectFrame &frame, const EffectSettings &settings)
+{
+  if (!lookupTablesReady)
+    buildLookupTables();
+
+  const EffectDescriptor &effect = effectRegistry[id];
+  effect.render(frame, effect.params, settings);
+}
+
+static void buildLookupTables()
+{
+  for (int i = 0; i < 256; i++)
+  {
+    hsv2rgb_rainbow(CHSV(i, 255, 255), rainbowLut[i]);
+    hsv2rgb_rainbow(CHSV(i, 240, 255), fillRainbowLut[i]);
+    hsv2rgb_rainbow(CHSV(i, 200, 255), waitingLut[i]);
+
+    // Brightness 100..255, squared the way hsv2rgb_rainbow() treats its value
+    uint8_t brightness = 100 + scale8(sin8(i), 155);
+    waveLut[i] = scale8_video(brightness, brightness);
+  }
+  lookupTablesReady = true;
+}
+
+// Animation phase: advances by params.step every EFFECT_STEP_MS
+static uint32_t effectPhase(uint32_t now, const EffectParams &params)
+{
+  return (uint64_t)now * params.step / EFFECT_STEP_MS;
+}
+
+static void effectRainbow(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  // One full hue cycle across the strip. The per-pixel offset i * 255 / count
+  // is stepped in 16.16 fixed point, which needs no division and no
+  // per-length table.
+  uint32_t hue = (uint32_t)(uint8_t)effectPhase(frame.now, params) << 16;
+  uint32_t step = (255UL << 16) / frame.count;
+  for (int i = 0; i < frame.count; i++)
+  {
+    frame.leds[i] = rainbowLut[(uint8_t)(hue >> 16)];
+    hue += step;
+  }
+}
+
+static void effectFillRainbow(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  uint8_t hue = effectPhase(frame.now, params);
+  for (int i = 0; i < frame.count; i++)
+  {
+    frame.leds[i] = fillRainbowLut[hue];
+    hue += 7;
+  }
+}
+
+static void effectStatic(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  fill_solid(frame.leds, frame.count, settings.staticColor);
+}
+
+static void effectSnake(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  // Trail fades by 50 per EFFECT_STEP_MS
+  fadeToBlackBy(frame.leds, frame.count, min<uint32_t>(255, 50 * frame.elapsed / EFFECT_STEP_MS));
+  if (frame.count < 2)
+    return;
+
+  // Bounce between both ends
+  uint32_t span = frame.count - 1;
+  uint32_t travel = effectPhase(frame.now, params) % (2 * span);
+  int position = travel <= span ? travel : 2 * span - travel;
+
+  // Fill the pixels skipped since the last frame so the head leaves no gaps
+  int &snakePosition = frame.state->snakePosition;
+  if (snakePosition >= frame.count)
+    snakePosition = position; // Strip got shorter since the last frame
+  int from = min(snakePosition, position);
+  int to = max(snakePosition, position);
+  if (to - from > 1 && frame.elapsed > EFFECT_STEP_MS * 4)
+    from = to = position; // Long stall, don't smear across the strip
+  for (int i = from; i <= to; i++)
+  {
+    frame.leds[i] = settings.snakeColor;
+  }
+  snakePosition = position;
+}
+
+static void effectWaiting(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  // Soft rainbow wave, brightness pulses at 20 BPM
+  uint8_t hue = effectPhase(frame.now, params);
+  uint8_t beat = (uint64_t)frame.now * 20 * 256 / 60000;
+  for (int i = 0; i < frame.count; i++)
+  {
+    frame.leds[i] = waitingLut[hue];
+    frame.leds[i].nscale8_video(waveLut[beat]);
+    hue += 20;
+    beat += 10;
+  }
+}
+
+static void effectBreathe(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  // Triangle wave between 50 and 255
+  const uint32_t range = 255 - 50;
+  uint32_t travel = effectPhase(frame.now, params) % (2 * range);
+  uint8_t brightness = 50 + (travel <= range ? travel : 2 * range - travel);
+  fill_solid(frame.leds, frame.count, CHSV(params.hue, 255, brightness));
+}
+
+static void effectBlink(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  bool blinkState = (frame.now / params.periodMs) & 1;
+  fill_solid(frame.leds, frame.count, blinkState ? CRGB(CRGB::Red) : CRGB(CRGB::Black));
+}
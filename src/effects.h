@@ -0,0 +1,90 @@
+#pragma once
+
+#include <FastLED.h>
+
+// Effect IDs, resolved from HTTP names once per request
+enum EffectId : uint8_t
+{
+  EFFECT_RAINBOW,
+  EFFECT_FILL_RAINBOW,
+  EFFECT_STATIC,
+  EFFECT_SNAKE,
+  EFFECT_WAITING,
+  EFFECT_BREATHE_GREEN,
+  EFFECT_BLINK_RED,
+  EFFECT_BREATHE_AMBER,
+  EFFECT_TIMELINE,
+  EFFECT_CHECKING, // Status effect until the first probe result, appended to keep saved ids
+  EFFECT_COUNT,
+  EFFECT_NONE = 0xFF
+};
+
+// Descriptor flags
+#define EFFECT_MENU_SETUP 0x01      // Button on the factory setup page
+#define EFFECT_MENU_MONITORING 0x02 // Button on the monitoring page
+#define EFFECT_STATUS 0x04          // Driven by the internet check
+#define EFFECT_STILL 0x08           // Frame only changes when settings do
+
+#define EFFECT_STEP_MS 50 // Time base for EffectParams::step
+
+// Fixed tuning for one effect
+struct EffectParams
+{
+  uint8_t hue;       // Base hue
+  uint8_t step;      // Hue/brightness/position change per EFFECT_STEP_MS
+  uint16_t periodMs; // Blink period
+};
+
+// User-adjustable inputs, owned by the render task
+struct EffectSettings
+{
+  CRGB staticColor;
+  CRGB snakeColor;
+};
+
+// Animation state of one effect instance, so segments running the same
+// effect do not share it. Zeroed when a segment switches effects.
+struct EffectState
+{
+  int snakePosition; // Head position drawn in the previous frame
+};
+
+// One frame to draw. Effects derive their animation from the clock rather
+// than from the number of frames, so speed does not depend on frame rate.
+struct EffectFrame
+{
+  CRGB *leds;
+  int count;
+  uint32_t now;     // Milliseconds
+  uint32_t elapsed; // Milliseconds since the previous frame
+  EffectState *state;
+};
+
+typedef void (*EffectRenderFn)(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
+
+struct EffectDescriptor
+{
+  const char *name;  // Name used by the HTTP API
+  const char *label; // Button text in the web UI
+  EffectRenderFn render;
+  EffectParams params;
+  uint8_t flags;
+};
+
+extern const EffectDescriptor effectRegistry[EFFECT_COUNT];
+
+// Returns EFFECT_NONE for unknown names
+EffectId findEffect(const char *name);
+
+// Parses "#RRGGBB", returns false if malformed
+bool parseHexColor(const char *text, CRGB &color);
+
+// Writes "#RRGGBB", text must hold 8 bytes
+void formatHexColor(const CRGB &color, char *text);
+
+// Effect the strip should show after an internet check, given the current one
+EffectId statusEffect(EffectId current, bool internet, bool degraded);
+
+// Effects only see the frame and their inputs, so they can be driven
+// without Arduino globals
+void renderEffect(EffectId id, const EffectFrame &frame, const EffectSettings &settings);
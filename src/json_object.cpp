@@ -0,0 +1,84 @@
+#include "json_object.h"
+
+static char *skipSpace(char *p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    p++;
+  return p;
+}
+
+// Unescapes a string in place, starting after the opening quote.
+// Returns the position after the closing quote, or NULL.
+static char *parseString(char *p, const char *&value)
+{
+  value = p;
+  char *out = p;
+  while (*p != '"')
+  {
+    if (*p == '\0')
+      return NULL;
+    if (*p == '\\')
+    {
+      p++;
+      if (*p != '"' && *p != '\\' && *p != '/')
+        return NULL;
+    }
+    *out++ = *p++;
+  }
+  *out = '\0'; // The closing quote is at or after out, so this never clobbers unread input
+  return p + 1;
+}
+
+int parseJsonObject(char *json, JsonField *fields, uint8_t maxFields)
+{
+  char *p = skipSpace(json);
+  if (*p++ != '{')
+    return -1;
+
+  int count = 0;
+  p = skipSpace(p);
+  if (*p == '}')
+    return *skipSpace(p + 1) == '\0' ? 0 : -1;
+
+  for (;;)
+  {
+    if (count == maxFields || *p++ != '"')
+      return -1;
+
+    JsonField &field = fields[count++];
+    p = parseString(p, field.key);
+    if (p == NULL)
+      return -1;
+
+    p = skipSpace(p);
+    if (*p++ != ':')
+      return -1;
+    p = skipSpace(p);
+
+    if (*p == '"')
+    {
+      p = parseString(p + 1, field.text);
+      if (p == NULL)
+        return -1;
+      field.number = 0;
+    }
+    else
+    {
+      char *end;
+      field.text = NULL;
+      field.number = strtol(p, &end, 10);
+      if (end == p)
+        return -1;
+      p = end;
+    }
+
+    p = skipSpace(p);
+    if (*p == '}')
+      break;
+    if (*p++ != ',')
+      return -1;
+    p = skipSpace(p);
+  }
+
+  return *skipSpace(p + 1) == '\0' ? count : -1;
+}
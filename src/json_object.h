@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+
+// One member of a flat JSON object. key and text point into the parsed buffer.
+struct JsonField
+{
+  const char *key;
+  const char *text; // String value, NULL for numbers
+  long number;
+};
+
+// Parses a flat object of string and integer members, e.g.
+// {"effect":"static","color":"#00FF00","fps":30}, in place: keys and strings
+// are terminated inside json. Nested values, floats and \u escapes are not
+// supported. Returns the member count, or -1 if malformed or over maxFields.
+int parseJsonObject(char *json, JsonField *fields, uint8_t maxFields);
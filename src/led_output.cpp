@@ -0,0 +1,242 @@
+#include "led_output.h"
+#include <freertos/semphr.h>
+
+// Pins a strip may be configured on. Every pin needs its own template
+// instantiation, so this list is kept to the usual output-capable GPIOs
+// (14 is the reset button).
+#define LED_OUTPUT_PINS(X) \
+  X(2) X(4) X(5) X(12) X(13) X(15) X(16) X(17) X(18) X(19) X(21) X(22) X(23) X(25) X(26) X(27) X(32) X(33)
+
+StripConfig strips[MAX_STRIPS];
+uint8_t stripCount = 0;
+int ledCount = 0;
+
+// Double buffered: effects draw into the back buffer while the front one is shown
+static CRGB *frameBuffers[2] = {NULL, NULL};
+static CRGB *leds = NULL;                  // Back buffer, only touched by the render task
+static CRGB *volatile frontBuffer = NULL;
+static CLEDController *stripControllers[MAX_STRIPS];
+
+// Output task: sends the front buffer while the render task computes the next frame
+static TaskHandle_t outputTaskHandle = NULL;
+static SemaphoreHandle_t outputIdle = NULL; // Given while no frame is being sent
+static OutputStats stats = {0, 0, 0, 0, 0, 0.0f};
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED; // stats are read from the other core
+
+static void outputTask(void *param);
+
+static const char *colorOrderNames[STRIP_ORDER_COUNT] = {"GRB", "RGB", "BRG"};
+
+template <uint8_t PIN>
+static CLEDController *addStripOnPin(CRGB *data, int length, uint8_t order)
+{
+  switch (order)
+  {
+  case STRIP_ORDER_RGB:
+    return &FastLED.addLeds<WS2812B, PIN, RGB>(data, length);
+  case STRIP_ORDER_BRG:
+    return &FastLED.addLeds<WS2812B, PIN, BRG>(data, length);
+  default:
+    return &FastLED.addLeds<WS2812B, PIN, GRB>(data, length);
+  }
+}
+
+static CLEDController *addStrip(const StripConfig &strip, CRGB *data)
+{
+  switch (strip.pin)
+  {
+#define ADD_STRIP_CASE(pin) \
+  case pin:                 \
+    return addStripOnPin<pin>(data, strip.length, strip.colorOrder);
+    LED_OUTPUT_PINS(ADD_STRIP_CASE)
+#undef ADD_STRIP_CASE
+  default:
+    return NULL;
+  }
+}
+
+bool isValidStripPin(uint8_t pin)
+{
+  switch (pin)
+  {
+#define VALID_PIN_CASE(pin) case pin:
+    LED_OUTPUT_PINS(VALID_PIN_CASE)
+#undef VALID_PIN_CASE
+    return true;
+  default:
+    return false;
+  }
+}
+
+const char *stripColorOrderName(uint8_t order)
+{
+  return order < STRIP_ORDER_COUNT ? colorOrderNames[order] : "?";
+}
+
+int findStripColorOrder(const char *name)
+{
+  for (uint8_t i = 0; i < STRIP_ORDER_COUNT; i++)
+  {
+    if (strcasecmp(colorOrderNames[i], name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static bool isValidStripConfig(const StripConfig *config, uint8_t count)
+{
+  if (count == 0 || count > MAX_STRIPS)
+    return false;
+
+  int total = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!isValidStripPin(config[i].pin) || config[i].colorOrder >= STRIP_ORDER_COUNT || config[i].length == 0)
+      return false;
+    for (uint8_t j = 0; j < i; j++)
+    {
+      if (config[j].pin == config[i].pin)
+        return false;
+    }
+    total += config[i].length;
+  }
+  return total <= MAX_TOTAL_LEDS;
+}
+
+void loadStripConfig(Preferences &prefs)
+{
+  StripConfig config[MAX_STRIPS];
+  size_t size = prefs.getBytes("strips", config, sizeof(config));
+  uint8_t count = size / sizeof(StripConfig);
+
+  if (size % sizeof(StripConfig) == 0 && isValidStripConfig(config, count))
+  {
+    memcpy(strips, config, size);
+    stripCount = count;
+  }
+  else
+  {
+    strips[0].pin = DEFAULT_STRIP_PIN;
+    strips[0].colorOrder = STRIP_ORDER_GRB;
+    strips[0].length = DEFAULT_STRIP_LENGTH;
+    stripCount = 1;
+  }
+
+  ledCount = 0;
+  for (uint8_t i = 0; i < stripCount; i++)
+  {
+    ledCount += strips[i].length;
+  }
+}
+
+bool saveStripConfig(Preferences &prefs, const StripConfig *config, uint8_t count)
+{
+  if (!isValidStripConfig(config, count))
+    return false;
+  return prefs.putBytes("strips", config, sizeof(StripConfig) * count) == sizeof(StripConfig) * count;
+}
+
+bool beginLedOutput(uint8_t brightness)
+{
+  frameBuffers[0] = (CRGB *)calloc(ledCount, sizeof(CRGB));
+  frameBuffers[1] = (CRGB *)calloc(ledCount, sizeof(CRGB));
+  if (frameBuffers[0] == NULL || frameBuffers[1] == NULL)
+    return false;
+
+  leds = frameBuffers[0];
+  frontBuffer = frameBuffers[1];
+
+  // Each strip shows its own slice of the front buffer. FastLED starts all
+  // RMT channels before waiting, so the strips are clocked out in parallel.
+  int offset = 0;
+  for (uint8_t i = 0; i < stripCount; i++)
+  {
+    stripControllers[i] = addStrip(strips[i], frontBuffer + offset);
+    offset += strips[i].length;
+  }
+
+  FastLED.setBrightness(brightness);
+
+  // The output task sends the first (cleared) frame right away
+  outputIdle = xSemaphoreCreateBinary();
+  xTaskCreatePinnedToCore(outputTask, "ledOutput", 2048, NULL, 3, &outputTaskHandle, OUTPUT_CORE);
+  xTaskNotifyGive(outputTaskHandle);
+  return true;
+}
+
+CRGB *backBuffer()
+{
+  return leds;
+}
+
+bool presentFrame()
+{
+  if (xSemaphoreTake(outputIdle, 0) != pdTRUE)
+  {
+    portENTER_CRITICAL(&statsLock);
+    stats.framesDropped++;
+    portEXIT_CRITICAL(&statsLock);
+    return false; // Keep drawing into the same back buffer
+  }
+
+  CRGB *finished = leds;
+  leds = (CRGB *)frontBuffer;
+  frontBuffer = finished;
+
+  int offset = 0;
+  for (uint8_t i = 0; i < stripCount; i++)
+  {
+    stripControllers[i]->setLeds(finished + offset, strips[i].length);
+    offset += strips[i].length;
+  }
+  xTaskNotifyGive(outputTaskHandle);
+  return true;
+}
+
+OutputStats outputStats()
+{
+  portENTER_CRITICAL(&statsLock);
+  OutputStats copy = stats;
+  portEXIT_CRITICAL(&statsLock);
+  return copy;
+}
+
+static void outputTask(void *param)
+{
+  uint32_t windowStart = millis();
+  uint32_t windowFrames = 0;
+
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // show() blocks on the RMT completion, which frees the CPU for the
+    // render task in the meantime
+    uint32_t start = micros();
+    FastLED.show();
+    uint32_t elapsed = micros() - start;
+    windowFrames++;
+
+    uint32_t now = millis();
+    bool windowDone = now - windowStart >= 1000;
+    float fps = windowDone ? windowFrames * 1000.0f / (now - windowStart) : 0.0f;
+
+    portENTER_CRITICAL(&statsLock);
+    stats.showTimeUs = elapsed;
+    if (elapsed > stats.showTimeMaxUs)
+      stats.showTimeMaxUs = elapsed;
+    stats.showTimeTotalUs += elapsed;
+    stats.framesShown++;
+    if (windowDone)
+      stats.fps = fps;
+    portEXIT_CRITICAL(&statsLock);
+
+    if (windowDone)
+    {
+      windowStart = now;
+      windowFrames = 0;
+    }
+
+    xSemaphoreGive(outputIdle);
+  }
+}
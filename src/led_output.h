@@ -0,0 +1,70 @@
+#pragma once
+
+#include <FastLED.h>
+#include <Preferences.h>
+
+#define MAX_STRIPS 4           // Parallel outputs, each gets its own RMT channel
+#define MAX_TOTAL_LEDS 4000    // Upper bound for all strips together
+#define DEFAULT_STRIP_PIN 4    // GPIO pin used when nothing is configured
+#define DEFAULT_STRIP_LENGTH 300
+#define OUTPUT_CORE 0          // Core for the output task, next to the render task
+
+// Color orders a strip can be configured with
+enum StripColorOrder : uint8_t
+{
+  STRIP_ORDER_GRB,
+  STRIP_ORDER_RGB,
+  STRIP_ORDER_BRG,
+  STRIP_ORDER_COUNT
+};
+
+// Output counters, updated under a spinlock by the output task and
+// presentFrame(). Read them through outputStats(), which copies them whole.
+struct OutputStats
+{
+  uint32_t framesShown;
+  uint32_t framesDropped; // Frames finished while the previous one was still being sent
+  uint32_t showTimeUs;    // Duration of the last FastLED.show()
+  uint32_t showTimeMaxUs;
+  uint64_t showTimeTotalUs;
+  float fps;              // Frames shown during the last second
+};
+
+struct StripConfig
+{
+  uint8_t pin;
+  uint8_t colorOrder; // StripColorOrder
+  uint16_t length;
+};
+
+extern StripConfig strips[MAX_STRIPS];
+extern uint8_t stripCount;
+extern int ledCount; // All strips back to back, as effects see them
+
+// Reads the strip layout from preferences, falls back to one default strip
+void loadStripConfig(Preferences &prefs);
+
+// Validates and stores a layout, applied on the next boot
+bool saveStripConfig(Preferences &prefs, const StripConfig *config, uint8_t count);
+
+bool isValidStripPin(uint8_t pin);
+const char *stripColorOrderName(uint8_t order);
+int findStripColorOrder(const char *name);
+
+// Allocates the frame buffers, registers one FastLED controller per strip
+// and starts the output task. Each strip goes out on its own RMT channel;
+// FastLED's parallel I2S driver is not used, the output task is what keeps
+// the wait for the transfer off the render task.
+bool beginLedOutput(uint8_t brightness);
+
+// Buffer the render task composes the next frame into. Its content is
+// undefined after presentFrame(), every frame must be written in full.
+CRGB *backBuffer();
+
+// Hands the finished back buffer to the output task and returns without
+// waiting for it to be sent. The frame is dropped if the previous one is
+// still going out; returns false then, and the back buffer keeps its content.
+bool presentFrame();
+
+// Consistent copy of the counters, callable from any core
+OutputStats outputStats();
@@ -1,165 +1,489 @@
 #include <WebServer.h>
-#include <HTTPClient.h>
 #include <FastLED.h>
 #include <Preferences.h>
-#include <DNSServer.h>
+#include <lwip/sockets.h>
+#include "effects.h"
+#include "led_output.h"
+#include "probe.h"
+#include "metrics.h"
+#include "timeline.h"
+#include "compositor.h"
+#include "segments.h"
+#include "json_object.h"
+#include "settings.h"
+#include "scheduler.h"
+#include "captive_dns.h"
+#include "benchmark.h"
+#include "web_assets.h" // Generated from web/ by tools/embed_web_assets.py
 
 // Configuration defines
-#define LED_PIN 4                    // GPIO pin for LED strip
 #define RESET_PIN 14                 // GPIO pin for factory reset button
-#define NUM_LEDS 300                 // Number of LEDs in strip
 #define INTERNET_CHECK_INTERVAL 5000 // Internet check interval in milliseconds
 #define BRIGHTNESS 100               // LED brightness (0-255)
-
-// LED strip
-CRGB leds[NUM_LEDS];
-
-// Web server and DNS server
-WebServer server(80);
-DNSServer dnsServer;
+#define DEFAULT_FPS 20               // Target frame rate
+#define MAX_FPS 100                  // Upper bound accepted from the web UI
+#define MIN_SPEED 10                 // Effect speed limits in percent of normal
+#define MAX_SPEED 400
+#define MAX_COMMAND_SIZE 256         // Largest /command body
+#define MAX_COMMAND_FIELDS 8         // Members in one /command batch
+#define PAGE_CHUNK_SIZE 512          // Chunks of streamed responses, also the longest single page.printf()
+#define STILL_FRAME_WAIT 1000        // Longest sleep while a still effect is shown, in milliseconds
+#define RENDER_CORE 0                // Core for the render task (Arduino loop runs on core 1)
+#define EVENTS_PORT 81               // Server-Sent Events port for live status
+#define MAX_EVENT_CLIENTS 4          // Concurrent live status subscribers
+#define EVENTS_POLL_INTERVAL 500     // How often live status is compared, in milliseconds
+#define EVENTS_KEEPALIVE 15000       // Keepalive comment interval in milliseconds
+#define WIFI_CONNECT_TIMEOUT 10000   // Give up on an association after this many milliseconds
+#define MAX_SCAN_RESULTS 16          // Networks kept in the scan cache
+#define SCAN_CACHE_TTL 30000         // Scan results older than this trigger a rescan, in milliseconds
+#define HTTP_PORT 80
+#define HTTP_POLL_INTERVAL 2         // Web server poll period in milliseconds while it holds a client
+#define SOCKET_REARM_INTERVAL 10     // Socket watcher recheck period while a socket waits for its task, in milliseconds
+#define INTERNET_POLL_INTERVAL 100   // How often finished probes are picked up, in milliseconds
+
+// Web server
+WebServer server(HTTP_PORT);
+
+// Live status push channel. It runs on its own port because WebServer
+// serves a single client at a time and cannot keep streams open.
+WiFiServer eventServer(EVENTS_PORT);
+WiFiClient eventClients[MAX_EVENT_CLIENTS];
 
 // Preferences for storing settings
 Preferences preferences;
 
 // Global variables
-String deviceMode = "factory"; // "factory" or "monitoring"
-String currentEffect = "waiting";
-String staticColor = "#00FF00";
-String snakeColor = "#FF0000"; // Default snake color
+enum DeviceMode : uint8_t
+{
+  MODE_BOOTING,
+  MODE_FACTORY,
+  MODE_MONITORING
+};
+DeviceMode deviceMode = MODE_BOOTING;
+EffectId currentEffect = EFFECT_WAITING;
+EffectSettings effectSettings = {CRGB(0x00, 0xFF, 0x00), CRGB(0xFF, 0x00, 0x00)};
+Segment segments[MAX_SEGMENTS]; // Strip layout, segment 0 shows currentEffect
 unsigned long lastInternetCheck = 0;
 bool internetStatus = false;
+unsigned long lastProbeLatency = 0;
 bool factoryResetPressed = false;
 unsigned long factoryResetPressTime = 0;
 
-// Effect variables
-uint8_t effectHue = 0;
-uint8_t breatheBrightness = 50;
-int8_t breatheDirection = 1;
-unsigned long lastEffectUpdate = 0;
-int snakePosition = 0;
-int snakeDirection = 1;
+// Render task state, updated only through effectCommandQueue
+struct EffectCommand
+{
+  Segment segments[MAX_SEGMENTS]; // Segment 0 carries currentEffect
+  EffectSettings settings;
+  uint8_t fps;
+  uint8_t brightness;
+  uint16_t speed; // Percent of normal effect speed
+  StatusOverlay overlay;
+};
+EffectCommand renderState;
+StatusOverlay postedOverlay = OVERLAY_NONE; // Overlay sent with the last command
+bool frameDirty = true; // Set when renderState changes, lets still effects skip frames
+EffectState segmentStates[MAX_SEGMENTS]; // Render task, animation state per segment
+uint8_t segmentsDirty = 0xFF; // Render task, segments whose still effects must be drawn again
+bool layoutChanged = true; // Render task, pixels outside the segments must be cleared
+volatile bool benchmarkRequested = false;
+uint8_t targetFps = DEFAULT_FPS;
+uint8_t ledBrightness = BRIGHTNESS;
+uint16_t effectSpeed = 100;
+EffectId savedEffect = EFFECT_BREATHE_GREEN; // Last effect the user picked, a status effect means "show the status"
+
+// Render scheduler statistics, written by the render task
+struct RenderStats
+{
+  uint32_t frames;
+  uint32_t computeUs;   // Effect render time of the last frame
+  uint32_t jitterUs;    // Smoothed |actual - target| frame interval
+  uint32_t jitterMaxUs;
+  uint32_t idleWaits;   // Wakeups with nothing to draw
+};
+RenderStats renderStats = {0, 0, 0, 0, 0};
+QueueHandle_t effectCommandQueue = NULL;
+
+// Last state pushed to live status subscribers
+struct LiveStatus
+{
+  bool wifiConnected;
+  bool internet;
+  InternetState internetState;
+  EffectId effect;
+  int rssi;
+  unsigned long latencyMs;
+};
+LiveStatus publishedStatus;
+unsigned long lastEventsKeepalive = 0;
+
+// WiFi provisioning state machine, advanced from loop() by WiFi events
+enum ProvisionState
+{
+  PROVISION_IDLE,
+  PROVISION_CONNECTING,
+  PROVISION_CONNECTED,
+  PROVISION_FAILED
+};
+ProvisionState provisionState = PROVISION_IDLE;
+bool provisionFromBoot = false; // Saved credentials at boot vs. /connect from the portal
+unsigned long provisionStarted = 0;
+char provisionSSID[33] = "";
+char provisionPassword[65] = "";
+volatile bool wifiGotIP = false;
+volatile uint8_t wifiDisconnectReason = 0;
+unsigned long restartAt = 0; // Pending restart time, 0 if none
+
+// loop() sleeps on a task notification between scheduler passes
+TaskHandle_t loopTaskHandle = NULL;
+int provisioningTask = -1;
+
+// Sockets whose scheduler task runs only when they are readable. A socket
+// is watched until it becomes readable, then armed again once its task ran.
+struct WatchedSocket
+{
+  int fd;
+  int task;
+  volatile bool armed;
+};
+WatchedSocket httpSocket = {-1, -1, false}; // Web server listen socket
+WatchedSocket dnsSocket = {-1, -1, false};  // Captive portal DNS
+TaskHandle_t socketWatchHandle = NULL;
+
+// WiFi scan cache, filled by asynchronous scans
+struct ScanEntry
+{
+  char ssid[33];
+  int8_t rssi;
+  bool secure;
+};
+ScanEntry scanResults[MAX_SCAN_RESULTS];
+uint8_t scanResultCount = 0;
+unsigned long scanTimestamp = 0;
+bool scanValid = false;
+bool scanRunning = false;
+
 
 // Function declarations
 void startFactoryMode();
 void startMonitoringMode();
+void onRoute(const char *path, HTTPMethod method, WebServer::THandlerFunction handler);
+void onRoute(const char *path, HTTPMethod method, WebServer::THandlerFunction handler, void (*uploadHandler)());
+WebServer::THandlerFunction timedRoute(const char *path, HTTPMethod method, WebServer::THandlerFunction handler);
+void registerWebAssets();
 void handleRoot();
 void handleMonitoringRoot();
-void handleCSS();
+void sendWebAsset(const WebAsset &asset);
 void handleWiFiScan();
+void startWiFiScan();
+void checkWiFiScan();
+void addScanResult(const char *ssid, int8_t rssi, bool secure);
+void streamJsonString(const char *text);
 void handleWiFiConnect();
+void handleWiFiConnectStatus();
+void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info);
+void beginProvisioning(const char *ssid, const char *password, bool fromBoot);
+void updateProvisioning();
+void scheduleRestart(unsigned long delayMs);
 void handleEffectChange();
+void handleCommand();
 void handleFactoryResetWeb();
 void handleMonitoringMode();
 void handleStatus();
+void handleStripConfig();
+void handleStripConfigSave();
+void handleTimeline();
+void handleTimelineUpload();
+void handleTimelineUploadDone();
 void checkFactoryReset();
+void checkSerialCommands();
+uint32_t schedulerClock();
+void wakeSchedulerTask(int id);
+void socketWatchTask(void *param);
+void armSocket(WatchedSocket &socket);
+int findListenSocket(uint16_t port);
+void watchHttpSocket();
+int openDnsSocket();
+void handleHttpClient();
+void processDnsRequests();
+void updateInternetCheck();
+void flushPendingSettings();
 void checkInternetConnection();
-void updateLEDEffects();
-void effectRainbow();
-void effectFillRainbow();
-void effectStatic();
-void effectSnake();
-void effectWaiting();
-void effectBreatheGreen();
-void effectBlinkRed();
+void handleProbes();
+void handleProbeTargets();
+void handleMetrics();
+void streamTimingMetric(const char *name, const char *help, const TimingMetric &metric);
+void acceptEventClients();
+void publishLiveStatus();
+void formatLiveStatus(const LiveStatus &status, char *buffer, size_t size);
+bool sendEvent(WiFiClient &client, const char *message);
+void postEffectCommand();
+void restoreSettings();
+void saveUserSettings();
+EffectId segmentEffect(uint8_t index);
+void applyEffectCommand(const EffectCommand &command);
+EffectId monitoringEffect();
+EffectId internetStatusEffect();
+StatusOverlay currentStatusOverlay();
+void renderTask(void *param);
+void updateLEDEffects(uint32_t now, uint32_t elapsed);
+void streamEffectButtons(uint8_t menu);
+void streamEffectControls();
+void logResponseCost(const char *route, unsigned long startMicros);
+void sendText(int code, const char *format, ...);
 
 void setup()
 {
   Serial.begin(115200);
   Serial.println("ESP32 WiFi Monitor Starting...");
 
-  // Initialize LED strip
-  FastLED.addLeds<WS2812B, LED_PIN, GRB>(leds, NUM_LEDS);
-  FastLED.setBrightness(BRIGHTNESS);
-  FastLED.clear();
-  FastLED.show();
-
   // Initialize preferences
   preferences.begin("wifi-monitor", false);
 
-  // Initialize reset button
-  pinMode(RESET_PIN, INPUT_PULLUP);
+  // Restore effect, colors, speed, brightness and segments from their single
+  // blob. Segments are checked against the strip, so the layout comes first.
+  loadStripConfig(preferences);
+  segments[0].length = ledCount;
+  restoreSettings();
 
   // Load saved settings
-  String savedSSID = preferences.getString("ssid", "");
-  String savedPassword = preferences.getString("password", "");
+  char savedSSID[sizeof(provisionSSID)] = "";
+  char savedPassword[sizeof(provisionPassword)] = "";
+  if (preferences.isKey("ssid"))
+  {
+    preferences.getString("ssid", savedSSID, sizeof(savedSSID));
+    preferences.getString("password", savedPassword, sizeof(savedPassword));
+  }
 
-  // Check if we have saved WiFi credentials
-  if (savedSSID.length() > 0)
+  // Light the strip first: a provisioned device shows the user's effect
+  // while WiFi associates, so a power cycle never leaves it dark
+  bool ledsReady = beginLedOutput(ledBrightness) && beginCompositor(ledCount);
+  Serial.printf("LED output: %u strip(s), %d LEDs%s\n", stripCount, ledCount, ledsReady ? "" : ", not enough memory");
+
+  // Start render task on the other core so web handlers cannot stall frames
+  currentEffect = savedSSID[0] != '\0' ? monitoringEffect() : EFFECT_WAITING;
+  effectCommandQueue = xQueueCreate(1, sizeof(EffectCommand));
+  postEffectCommand();
+  if (ledsReady)
+  {
+    xTaskCreatePinnedToCore(renderTask, "render", 4096, NULL, 2, NULL, RENDER_CORE);
+  }
+
+  // Mounting LittleFS can take a while, the timeline effect draws black until it is loaded
+  beginTimeline();
+
+  // Initialize reset button
+  pinMode(RESET_PIN, INPUT_PULLUP);
+
+  // Each subsystem runs on its own deadline instead of every loop pass.
+  // Budgets are the run times counted as overruns in /metrics.
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  setSchedulerClock(schedulerClock);
+  xTaskCreate(socketWatchTask, "sockets", 2048, NULL, 1, &socketWatchHandle);
+  httpSocket.task = addSchedulerTask("http", handleHttpClient, 0, 50000); // Runs once the server listens
+  provisioningTask = addSchedulerTask("provisioning", updateProvisioning, 100000, 5000);
+  addSchedulerTask("reset_button", checkFactoryReset, 50000, 1000);
+  addSchedulerTask("serial", checkSerialCommands, 50000, 1000);
+  addSchedulerTask("settings", flushPendingSettings, 250000, 50000);
+
+  // WiFi events drive the provisioning state machine
+  WiFi.onEvent(onWiFiEvent);
+
+  // Connect in the background, loop() picks the mode once association settles
+  if (savedSSID[0] != '\0')
   {
     Serial.println("Attempting to connect to saved WiFi...");
-    WiFi.begin(savedSSID.c_str(), savedPassword.c_str());
+    WiFi.mode(WIFI_STA);
+    beginProvisioning(savedSSID, savedPassword, true);
+  }
+  else
+  {
+    startFactoryMode();
+  }
 
-    // Wait for connection with timeout
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20)
+  Serial.println("Setup complete!");
+}
+
+void loop()
+{
+  uint32_t loopStart = micros();
+  uint32_t waitUs = runScheduler();
+  recordTiming(metrics.loop, micros() - loopStart);
+
+  // Sleep until the next deadline, WiFi events wake the loop early
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((waitUs + 999) / 1000));
+}
+
+uint32_t schedulerClock()
+{
+  return micros();
+}
+
+// Makes a task due now and wakes loop(), callable from other tasks
+void wakeSchedulerTask(int id)
+{
+  signalSchedulerTask(id);
+  xTaskNotifyGive(loopTaskHandle);
+}
+
+// Blocks in select() on the armed sockets and signals their tasks, so the
+// web server and DNS cost no loop() wakeups while nobody talks to them.
+// A signalled socket leaves the set until its task arms it again, otherwise
+// a connection the web server has not accepted yet would make this spin.
+void socketWatchTask(void *param)
+{
+  WatchedSocket *watched[] = {&httpSocket, &dnsSocket};
+  for (;;)
+  {
+    fd_set readable;
+    FD_ZERO(&readable);
+    int maxFd = -1;
+    bool waiting = false; // A socket is out of the set until its task runs
+    for (WatchedSocket *socket : watched)
     {
-      delay(500);
-      Serial.print(".");
-      attempts++;
+      if (socket->fd < 0)
+        continue;
+      if (!socket->armed)
+      {
+        waiting = true;
+        continue;
+      }
+      FD_SET(socket->fd, &readable);
+      maxFd = max(maxFd, socket->fd);
     }
-
-    if (WiFi.status() == WL_CONNECTED)
+    if (maxFd < 0)
     {
-      deviceMode = "monitoring";
-      Serial.println("\nConnected to WiFi!");
-      Serial.print("IP address: ");
-      Serial.println(WiFi.localIP());
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Until armSocket()
+      continue;
     }
-    else
+
+    // Arming cannot interrupt select(), so the set is rebuilt now and then while a socket is out of it
+    timeval recheck = {0, SOCKET_REARM_INTERVAL * 1000};
+    int ready = select(maxFd + 1, &readable, NULL, NULL, waiting ? &recheck : NULL);
+    for (WatchedSocket *socket : watched)
     {
-      Serial.println("\nFailed to connect to saved WiFi. Starting factory mode.");
-      deviceMode = "factory";
+      // After an error every task looks for itself rather than miss its data
+      if (socket->fd >= 0 && socket->armed && (ready < 0 || FD_ISSET(socket->fd, &readable)))
+      {
+        socket->armed = false;
+        wakeSchedulerTask(socket->task);
+      }
     }
+    if (ready < 0)
+      vTaskDelay(pdMS_TO_TICKS(SOCKET_REARM_INTERVAL));
   }
+}
 
-  // Start appropriate mode
-  if (deviceMode == "factory")
+// Puts a socket back into the watcher's set, called by its task once it ran
+void armSocket(WatchedSocket &socket)
+{
+  if (socket.fd < 0 || socket.armed)
+    return;
+  socket.armed = true;
+  xTaskNotifyGive(socketWatchHandle);
+}
+
+// WebServer keeps its listen socket to itself, so it is looked up among the
+// lwip sockets by its port. Returns -1 if there is none.
+int findListenSocket(uint16_t port)
+{
+  for (int fd = LWIP_SOCKET_OFFSET; fd < LWIP_SOCKET_OFFSET + CONFIG_LWIP_MAX_SOCKETS; fd++)
   {
-    startFactoryMode();
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    int listening = 0;
+    socklen_t optionLength = sizeof(listening);
+    if (getsockname(fd, (sockaddr *)&address, &length) == 0 && ntohs(address.sin_port) == port &&
+        getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &optionLength) == 0 && listening)
+      return fd;
   }
-  else
+  return -1;
+}
+
+// Called after server.begin(). Falls back to polling if the socket is not found.
+void watchHttpSocket()
+{
+  httpSocket.fd = findListenSocket(HTTP_PORT);
+  if (httpSocket.fd < 0)
   {
-    startMonitoringMode();
+    Serial.println("Web server socket not found, polling it instead");
+    setSchedulerTaskPeriod(httpSocket.task, HTTP_POLL_INTERVAL * 1000);
+    return;
   }
-
-  Serial.println("Setup complete!");
+  armSocket(httpSocket);
 }
 
-void loop()
+// Non-blocking UDP socket for the captive portal DNS, -1 on failure
+int openDnsSocket()
 {
-  // Handle DNS server in factory mode
-  if (deviceMode == "factory")
+  int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(DNS_PORT);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (fd >= 0 && bind(fd, (sockaddr *)&address, sizeof(address)) != 0)
   {
-    dnsServer.processNextRequest();
+    close(fd);
+    fd = -1;
   }
+  return fd;
+}
 
-  // Handle web server
+void handleHttpClient()
+{
   server.handleClient();
+  if (httpSocket.fd < 0)
+    return; // Polled
+
+  // WebServer serves one client at a time and has to be called until it
+  // lets go of it. The listen socket wakes the task for the next one.
+  bool busy = server.client();
+  setSchedulerTaskPeriod(httpSocket.task, busy ? HTTP_POLL_INTERVAL * 1000 : 0);
+  if (!busy)
+    armSocket(httpSocket);
+}
 
-  // Check factory reset button
-  checkFactoryReset();
-
-  // Update LED effects
-  updateLEDEffects();
+// Answers every pending query, phones send bursts of connectivity checks
+void processDnsRequests()
+{
+  uint8_t query[DNS_MAX_PACKET + 1]; // One spare byte tells oversized packets apart
+  uint8_t response[DNS_MAX_PACKET];
+  for (uint8_t i = 0; i < DNS_MAX_PACKETS_PER_TICK; i++)
+  {
+    sockaddr_in client;
+    socklen_t clientLength = sizeof(client);
+    int length = recvfrom(dnsSocket.fd, query, sizeof(query), MSG_DONTWAIT, (sockaddr *)&client, &clientLength);
+    if (length < 0)
+      break;
+    if (length > DNS_MAX_PACKET)
+      length = 0; // Oversized packets are dropped
+
+    size_t reply = answerCaptiveDns(client.sin_addr.s_addr, millis(), query, length, response);
+    if (reply != 0)
+      sendto(dnsSocket.fd, response, reply, MSG_DONTWAIT, (sockaddr *)&client, clientLength);
+  }
+  armSocket(dnsSocket); // Still readable if the burst was longer, then it runs again right away
+}
 
-  // Internet monitoring (only in monitoring mode)
-  if (deviceMode == "monitoring")
+void updateInternetCheck()
+{
+  if (!probePending() && millis() - lastInternetCheck >= INTERNET_CHECK_INTERVAL)
   {
-    if (millis() - lastInternetCheck >= INTERNET_CHECK_INTERVAL)
-    {
-      checkInternetConnection();
-      lastInternetCheck = millis();
-    }
+    requestProbe();
   }
+  checkInternetConnection();
+}
 
-  delay(10); // Small delay to prevent watchdog reset
+void flushPendingSettings()
+{
+  flushSettings(preferences);
 }
 
 void startFactoryMode()
 {
   Serial.println("Starting Factory Mode (AP)");
-  deviceMode = "factory";
-  currentEffect = "waiting";
+  deviceMode = MODE_FACTORY;
+  currentEffect = EFFECT_WAITING;
+  postEffectCommand();
 
   // Start Access Point
   WiFi.mode(WIFI_AP);
@@ -169,302 +493,456 @@ void startFactoryMode()
   Serial.println(WiFi.softAPIP());
 
   // Start DNS server for captive portal
-  dnsServer.start(53, "*", WiFi.softAPIP());
-  Serial.println("DNS server started for captive portal");
+  IPAddress portal = WiFi.softAPIP();
+  uint8_t portalAddress[4] = {portal[0], portal[1], portal[2], portal[3]};
+  beginCaptiveDns(portalAddress);
+  dnsSocket.task = addSchedulerTask("dns", processDnsRequests, 0, 2000);
+  dnsSocket.fd = openDnsSocket();
+  armSocket(dnsSocket);
+  Serial.println(dnsSocket.fd >= 0 ? "DNS server started for captive portal" : "DNS socket failed, no captive portal DNS");
+  addSchedulerTask("wifi_scan", checkWiFiScan, 100000, 5000);
 
   // Setup web server routes
-  server.on("/", handleRoot);
-  server.on("/scan", handleWiFiScan);
-  server.on("/connect", HTTP_POST, handleWiFiConnect);
-  server.on("/effect", HTTP_POST, handleEffectChange);
-  server.on("/style.css", handleCSS);
-  server.onNotFound(handleRoot); // Redirect all unknown requests to root
+  onRoute("/", HTTP_ANY, handleRoot);
+  onRoute("/scan", HTTP_ANY, handleWiFiScan);
+  onRoute("/connect", HTTP_POST, handleWiFiConnect);
+  onRoute("/connect/status", HTTP_ANY, handleWiFiConnectStatus);
+  onRoute("/strips", HTTP_GET, handleStripConfig);
+  onRoute("/strips", HTTP_POST, handleStripConfigSave);
+  onRoute("/effect", HTTP_POST, handleEffectChange);
+  onRoute("/command", HTTP_POST, handleCommand);
+  onRoute("/timeline", HTTP_GET, handleTimeline);
+  onRoute("/timeline", HTTP_POST, handleTimelineUploadDone, handleTimelineUpload);
+  onRoute("/metrics", HTTP_GET, handleMetrics);
+  registerWebAssets();
+  server.onNotFound(timedRoute("*", HTTP_ANY, handleRoot)); // Redirect all unknown requests to root
 
   server.begin();
+  watchHttpSocket();
   Serial.println("Factory mode web server started");
 }
 
 void startMonitoringMode()
 {
   Serial.println("Starting Monitoring Mode");
-  deviceMode = "monitoring";
-  currentEffect = "monitoring";
+  deviceMode = MODE_MONITORING;
+  currentEffect = monitoringEffect();
+  postEffectCommand();
 
   // Setup web server routes for monitoring mode
-  server.on("/", handleMonitoringRoot);
-  server.on("/effect", HTTP_POST, handleEffectChange);
-  server.on("/reset", HTTP_POST, handleFactoryResetWeb);
-  server.on("/monitoring", HTTP_POST, handleMonitoringMode);
-  server.on("/status", handleStatus);
-  server.on("/style.css", handleCSS);
+  onRoute("/", HTTP_ANY, handleMonitoringRoot);
+  onRoute("/effect", HTTP_POST, handleEffectChange);
+  onRoute("/command", HTTP_POST, handleCommand);
+  onRoute("/reset", HTTP_POST, handleFactoryResetWeb);
+  onRoute("/monitoring", HTTP_POST, handleMonitoringMode);
+  onRoute("/status", HTTP_ANY, handleStatus);
+  onRoute("/probes", HTTP_GET, handleProbes);
+  onRoute("/probes", HTTP_POST, handleProbeTargets);
+  onRoute("/strips", HTTP_GET, handleStripConfig);
+  onRoute("/strips", HTTP_POST, handleStripConfigSave);
+  onRoute("/timeline", HTTP_GET, handleTimeline);
+  onRoute("/timeline", HTTP_POST, handleTimelineUploadDone, handleTimelineUpload);
+  onRoute("/metrics", HTTP_GET, handleMetrics);
+  registerWebAssets();
 
   server.begin();
+  watchHttpSocket();
+  eventServer.begin();
+  addSchedulerTask("internet", updateInternetCheck, INTERNET_POLL_INTERVAL * 1000, 5000);
+  addSchedulerTask("event_clients", acceptEventClients, 100000, 5000);
+  addSchedulerTask("live_status", publishLiveStatus, EVENTS_POLL_INTERVAL * 1000, 20000);
   Serial.println("Monitoring mode web server started");
 
   // Initial internet check
-  checkInternetConnection();
+  beginProbe(preferences);
+  requestProbe();
+}
+
+// Static page fragments, the dynamic fields are streamed in between
+static const char PAGE_HEAD[] PROGMEM = R"rawliteral(<!DOCTYPE html><html><head>
+<meta name='viewport' content='width=device-width, initial-scale=1'>
+<link rel='stylesheet' href='/style.css'>)rawliteral";
+
+static const char SETUP_PAGE_TOP[] PROGMEM = R"rawliteral(<title>ESP32 WiFi Monitor - Setup</title>
+</head><body><div class='container'>
+<h1>ESP32 WiFi Monitor</h1>
+<h2>Factory Setup Mode</h2>
+<div class='section'>
+<h3>Available WiFi Networks</h3>
+<button onclick='scanNetworks()' class='btn'>Scan Networks</button>
+<div id='networks'></div>
+</div>
+<div class='section'>
+<h3>Connect to Network</h3>
+<form onsubmit='connectToWiFi(event)'>
+<input type='text' id='ssid' placeholder='Network Name (SSID)' required>
+<input type='password' id='password' placeholder='Password'>
+<button type='submit' class='btn btn-primary'>Connect</button>
+</form>
+</div>
+<div class='section'>
+<h3>LED Effects</h3>
+<div class='effects-grid'>)rawliteral";
+
+static const char MONITORING_PAGE_TOP[] PROGMEM = R"rawliteral(<title>ESP32 WiFi Monitor - Status</title>
+</head><body><div class='container'>
+<h1>ESP32 WiFi Monitor</h1>
+<h2>Monitoring Mode</h2>
+<div class='section'>
+<h3>Connection Status</h3>
+<div class='status-grid'>)rawliteral";
+
+static const char MONITORING_PAGE_EFFECTS[] PROGMEM = R"rawliteral(</div>
+</div>
+<div class='section'>
+<h3>LED Effects</h3>
+<div class='effects-grid'>)rawliteral";
+
+// Effect controls, one template per control so each formats into a chunk
+static const char STATIC_COLOR_CONTROL[] PROGMEM = R"rawliteral(</div>
+<div id='colorPicker' style='display:none; margin-top:10px;'>
+<label>Static Color: </label>
+<input type='color' id='staticColor' value='%s' oninput='updateStaticColor()'>
+</div>)rawliteral";
+
+static const char SNAKE_COLOR_CONTROL[] PROGMEM = R"rawliteral(
+<div id='snakeColorPicker' style='display:none; margin-top:10px;'>
+<label>Snake Color: </label>
+<input type='color' id='snakeColor' value='%s' oninput='updateSnakeColor()'>
+</div>)rawliteral";
+
+static const char SPEED_CONTROL[] PROGMEM = R"rawliteral(
+<div style='margin-top:10px;'>
+<label>Speed: </label>
+<input type='range' id='speed' min='%d' max='%d' value='%u' oninput='sendCommand({speed: +this.value})'>
+</div>)rawliteral";
+
+static const char BRIGHTNESS_CONTROL[] PROGMEM = R"rawliteral(
+<div style='margin-top:10px;'>
+<label>Brightness: </label>
+<input type='range' id='brightness' min='0' max='255' value='%u' oninput='sendCommand({brightness: +this.value})'>
+</div>
+</div>)rawliteral";
+
+static const char SETUP_PAGE_BOTTOM[] PROGMEM = R"rawliteral(</div>
+<script src='/effects.js'></script>
+<script src='/setup.js'></script>
+</body></html>)rawliteral";
+
+static const char MONITORING_PAGE_BOTTOM[] PROGMEM = R"rawliteral(<div class='section'>
+<h3>Factory Reset</h3>
+<button onclick='factoryReset()' class='btn btn-danger'>Reset to Factory Settings</button>
+</div>
+</div>
+<script src='/effects.js'></script>
+<script src='/monitoring.js'></script>
+</body></html>)rawliteral";
+
+// Collects small writes into fixed-size chunks of a chunked HTTP response
+struct ChunkWriter
+{
+  char buffer[PAGE_CHUNK_SIZE];
+  size_t used = 0;
+
+  void begin(const char *contentType)
+  {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, contentType, "");
+  }
+
+  void print(const char *text)
+  {
+    size_t length = strlen(text);
+    while (length > 0)
+    {
+      size_t n = min(length, sizeof(buffer) - used);
+      memcpy(buffer + used, text, n);
+      used += n;
+      text += n;
+      length -= n;
+      if (used == sizeof(buffer))
+        flush();
+    }
+  }
+
+  // Formats straight into the chunk buffer. Output that does not fit the
+  // free space is formatted again after a flush. One call has to fit a
+  // whole chunk, longer templates are split into several calls.
+  void printf(const char *format, ...)
+  {
+    va_list args;
+    va_list retry;
+    va_start(args, format);
+    va_copy(retry, args);
+    int length = vsnprintf(buffer + used, sizeof(buffer) - used, format, args);
+    if (length >= 0 && (size_t)length >= sizeof(buffer) - used && used > 0)
+    {
+      flush();
+      length = vsnprintf(buffer, sizeof(buffer), format, retry);
+    }
+    va_end(retry);
+    va_end(args);
+
+    if (length < 0)
+    {
+      Serial.printf("Bad page format: %s\n", format);
+      return;
+    }
+    if ((size_t)length >= sizeof(buffer) - used)
+    {
+      Serial.printf("Page output of %d bytes cut off, split the template: %.40s\n", length, format);
+      length = sizeof(buffer) - used - 1;
+    }
+    used += length;
+  }
+
+  void flush()
+  {
+    if (used > 0)
+      server.sendContent(buffer, used);
+    used = 0;
+  }
+
+  void end()
+  {
+    flush();
+    server.sendContent(""); // Terminating chunk
+  }
+};
+
+ChunkWriter page;
+
+// Registers a handler that is counted and timed for /metrics
+void onRoute(const char *path, HTTPMethod method, WebServer::THandlerFunction handler)
+{
+  server.on(path, method, timedRoute(path, method, handler));
+}
+
+// Same for uploads, the upload handler gets the body in chunks before handler runs
+void onRoute(const char *path, HTTPMethod method, WebServer::THandlerFunction handler, void (*uploadHandler)())
+{
+  server.on(path, method, timedRoute(path, method, handler), uploadHandler);
+}
+
+WebServer::THandlerFunction timedRoute(const char *path, HTTPMethod method, WebServer::THandlerFunction handler)
+{
+  RouteMetric *route = addRouteMetric(path, method);
+  if (route == NULL)
+    return handler; // Out of slots, serve it untimed
+
+  return [route, handler]()
+  {
+    uint32_t start = micros();
+    handler();
+    recordTiming(route->timing, micros() - start);
+  };
+}
+
+void registerWebAssets()
+{
+  static const char *headerKeys[] = {"If-None-Match"};
+  server.collectHeaders(headerKeys, 1);
+
+  // One handler per asset, so serving one needs no lookup by URI
+  for (size_t i = 0; i < webAssetCount; i++)
+  {
+    const WebAsset *asset = &webAssets[i];
+    onRoute(asset->path, HTTP_GET, [asset]() { sendWebAsset(*asset); });
+  }
 }
 
 void handleRoot()
 {
-  String html = "<!DOCTYPE html><html><head>";
-  html += "<title>ESP32 WiFi Monitor - Setup</title>";
-  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-  html += "<link rel='stylesheet' href='/style.css'>";
-  html += "</head><body>";
-  html += "<div class='container'>";
-  html += "<h1>ESP32 WiFi Monitor</h1>";
-  html += "<h2>Factory Setup Mode</h2>";
-
-  // WiFi Networks Section
-  html += "<div class='section'>";
-  html += "<h3>Available WiFi Networks</h3>";
-  html += "<button onclick='scanNetworks()' class='btn'>Scan Networks</button>";
-  html += "<div id='networks'></div>";
-  html += "</div>";
-
-  // Connection Form
-  html += "<div class='section'>";
-  html += "<h3>Connect to Network</h3>";
-  html += "<form onsubmit='connectToWiFi(event)'>";
-  html += "<input type='text' id='ssid' placeholder='Network Name (SSID)' required>";
-  html += "<input type='password' id='password' placeholder='Password'>";
-  html += "<button type='submit' class='btn btn-primary'>Connect</button>";
-  html += "</form>";
-  html += "</div>";
-
-  // LED Effects Section
-  html += "<div class='section'>";
-  html += "<h3>LED Effects</h3>";
-  html += "<div class='effects-grid'>";
-  html += "<button onclick='setEffect(\"rainbow\")' class='btn effect-btn'>Rainbow (HSV)</button>";
-  html += "<button onclick='setEffect(\"fill_rainbow\")' class='btn effect-btn'>Rainbow (Fill)</button>";
-  html += "<button onclick='setEffect(\"static\")' class='btn effect-btn'>Static Color</button>";
-  html += "<button onclick='setEffect(\"snake\")' class='btn effect-btn'>Snake</button>";
-  html += "<button onclick='setEffect(\"waiting\")' class='btn effect-btn'>Waiting</button>";
-  html += "</div>";
-  html += "<div id='colorPicker' style='display:none; margin-top:10px;'>";
-  html += "<label>Static Color: </label>";
-  html += "<input type='color' id='staticColor' value='#00FF00' onchange='updateStaticColor()'>";
-  html += "</div>";
-  html += "<div id='snakeColorPicker' style='display:none; margin-top:10px;'>";
-  html += "<label>Snake Color: </label>";
-  html += "<input type='color' id='snakeColor' value='#FF0000' onchange='updateSnakeColor()'>";
-  html += "</div>";
-  html += "</div>";
-
-  html += "</div>";
-  html += "<script>";
-  html += "function scanNetworks() {";
-  html += "  fetch('/scan').then(r => r.text()).then(data => {";
-  html += "    document.getElementById('networks').innerHTML = data;";
-  html += "  });";
-  html += "}";
-  html += "function selectNetwork(ssid) {";
-  html += "  document.getElementById('ssid').value = ssid;";
-  html += "}";
-  html += "function connectToWiFi(e) {";
-  html += "  e.preventDefault();";
-  html += "  const ssid = document.getElementById('ssid').value;";
-  html += "  const password = document.getElementById('password').value;";
-  html += "  fetch('/connect', {";
-  html += "    method: 'POST',";
-  html += "    headers: {'Content-Type': 'application/x-www-form-urlencoded'},";
-  html += "    body: `ssid=${encodeURIComponent(ssid)}&password=${encodeURIComponent(password)}`";
-  html += "  }).then(r => r.text()).then(data => {";
-  html += "    alert(data);";
-  html += "    if(data.includes('Success')) setTimeout(() => location.reload(), 3000);";
-  html += "  });";
-  html += "}";
-  html += "function setEffect(effect) {";
-  html += "  document.getElementById('colorPicker').style.display = 'none';";
-  html += "  document.getElementById('snakeColorPicker').style.display = 'none';";
-  html += "  if(effect === 'static') {";
-  html += "    document.getElementById('colorPicker').style.display = 'block';";
-  html += "  } else if(effect === 'snake') {";
-  html += "    document.getElementById('snakeColorPicker').style.display = 'block';";
-  html += "  }";
-  html += "  fetch('/effect', {";
-  html += "    method: 'POST',";
-  html += "    headers: {'Content-Type': 'application/x-www-form-urlencoded'},";
-  html += "    body: `effect=${effect}&color=${document.getElementById('staticColor').value}&snakeColor=${document.getElementById('snakeColor').value}`";
-  html += "  });";
-  html += "}";
-  html += "function updateStaticColor() {";
-  html += "  setEffect('static');";
-  html += "}";
-  html += "function updateSnakeColor() {";
-  html += "  setEffect('snake');";
-  html += "}";
-  html += "scanNetworks();";
-  html += "</script></body></html>";
-
-  server.send(200, "text/html", html);
+  unsigned long startMicros = micros();
+
+  page.begin("text/html");
+  page.print(PAGE_HEAD);
+  page.print(SETUP_PAGE_TOP);
+  streamEffectButtons(EFFECT_MENU_SETUP);
+  streamEffectControls();
+  page.print(SETUP_PAGE_BOTTOM);
+  page.end();
+
+  logResponseCost("/", startMicros);
 }
 
 void handleMonitoringRoot()
 {
-  String html = "<!DOCTYPE html><html><head>";
-  html += "<title>ESP32 WiFi Monitor - Status</title>";
-  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-  html += "<link rel='stylesheet' href='/style.css'>";
-  html += "<meta http-equiv='refresh' content='10'>";
-  html += "</head><body>";
-  html += "<div class='container'>";
-  html += "<h1>ESP32 WiFi Monitor</h1>";
-  html += "<h2>Monitoring Mode</h2>";
-
-  // Status Section
-  html += "<div class='section'>";
-  html += "<h3>Connection Status</h3>";
-  html += "<div class='status-grid'>";
-  html += "<div class='status-item'>";
-  html += "<span class='label'>WiFi:</span>";
-  html += "<span class='value " + String(WiFi.status() == WL_CONNECTED ? "connected" : "disconnected") + "'>";
-  html += WiFi.status() == WL_CONNECTED ? "Connected" : "Disconnected";
-  html += "</span></div>";
-  html += "<div class='status-item'>";
-  html += "<span class='label'>Network:</span>";
-  html += "<span class='value'>" + WiFi.SSID() + "</span>";
-  html += "</div>";
-  html += "<div class='status-item'>";
-  html += "<span class='label'>IP Address:</span>";
-  html += "<span class='value'>" + WiFi.localIP().toString() + "</span>";
-  html += "</div>";
-  html += "<div class='status-item'>";
-  html += "<span class='label'>Internet:</span>";
-  html += "<span class='value " + String(internetStatus ? "connected" : "disconnected") + "'>";
-  html += internetStatus ? "Available" : "Not Available";
-  html += "</span></div>";
-  html += "</div>";
-  html += "</div>";
-
-  // LED Effects Section
-  html += "<div class='section'>";
-  html += "<h3>LED Effects</h3>";
-  html += "<div class='effects-grid'>";
-  html += "<button onclick='setEffect(\"rainbow\")' class='btn effect-btn'>Rainbow (HSV)</button>";
-  html += "<button onclick='setEffect(\"fill_rainbow\")' class='btn effect-btn'>Rainbow (Fill)</button>";
-  html += "<button onclick='setEffect(\"static\")' class='btn effect-btn'>Static Color</button>";
-  html += "<button onclick='setEffect(\"snake\")' class='btn effect-btn'>Snake</button>";
-  html += "<button onclick='returnToMonitoring()' class='btn btn-monitoring'>Return to Monitoring</button>";
-  html += "</div>";
-  html += "<div id='colorPicker' style='display:none; margin-top:10px;'>";
-  html += "<label>Static Color: </label>";
-  html += "<input type='color' id='staticColor' value='" + staticColor + "' onchange='updateStaticColor()'>";
-  html += "</div>";
-  html += "<div id='snakeColorPicker' style='display:none; margin-top:10px;'>";
-  html += "<label>Snake Color: </label>";
-  html += "<input type='color' id='snakeColor' value='" + snakeColor + "' onchange='updateSnakeColor()'>";
-  html += "</div>";
-  html += "</div>";
-
-  // Reset Section
-  html += "<div class='section'>";
-  html += "<h3>Factory Reset</h3>";
-  html += "<button onclick='factoryReset()' class='btn btn-danger'>Reset to Factory Settings</button>";
-  html += "</div>";
-
-  html += "</div>";
-  html += "<script>";
-  html += "function setEffect(effect) {";
-  html += "  document.getElementById('colorPicker').style.display = 'none';";
-  html += "  document.getElementById('snakeColorPicker').style.display = 'none';";
-  html += "  if(effect === 'static') {";
-  html += "    document.getElementById('colorPicker').style.display = 'block';";
-  html += "  } else if(effect === 'snake') {";
-  html += "    document.getElementById('snakeColorPicker').style.display = 'block';";
-  html += "  }";
-  html += "  fetch('/effect', {";
-  html += "    method: 'POST',";
-  html += "    headers: {'Content-Type': 'application/x-www-form-urlencoded'},";
-  html += "    body: `effect=${effect}&color=${document.getElementById('staticColor').value}&snakeColor=${document.getElementById('snakeColor').value}`";
-  html += "  });";
-  html += "}";
-  html += "function updateStaticColor() {";
-  html += "  setEffect('static');";
-  html += "}";
-  html += "function updateSnakeColor() {";
-  html += "  setEffect('snake');";
-  html += "}";
-  html += "function returnToMonitoring() {";
-  html += "  fetch('/monitoring', {method: 'POST'}).then(() => {";
-  html += "    alert('Returned to monitoring mode');";
-  html += "  });";
-  html += "}";
-  html += "function factoryReset() {";
-  html += "  if(confirm('Are you sure you want to reset to factory settings?')) {";
-  html += "    fetch('/reset', {method: 'POST'}).then(() => {";
-  html += "      alert('Device will restart in factory mode');";
-  html += "      setTimeout(() => location.reload(), 3000);";
-  html += "    });";
-  html += "  }";
-  html += "}";
-  html += "</script></body></html>";
-
-  server.send(200, "text/html", html);
-}
-
-void handleCSS()
-{
-  String css = "body{font-family:Arial,sans-serif;margin:0;padding:20px;background:#f0f0f0}";
-  css += ".container{max-width:800px;margin:0 auto;background:white;padding:20px;border-radius:10px;box-shadow:0 2px 10px rgba(0,0,0,0.1)}";
-  css += "h1{color:#333;text-align:center;margin-bottom:10px}";
-  css += "h2{color:#666;text-align:center;margin-bottom:30px}";
-  css += "h3{color:#444;border-bottom:2px solid #007bff;padding-bottom:5px}";
-  css += ".section{margin-bottom:30px;padding:20px;background:#f8f9fa;border-radius:8px}";
-  css += ".btn{padding:10px 20px;border:none;border-radius:5px;cursor:pointer;font-size:14px;margin:5px}";
-  css += ".btn:hover{opacity:0.8}";
-  css += ".btn{background:#007bff;color:white}";
-  css += ".btn-primary{background:#28a745}";
-  css += ".btn-danger{background:#dc3545}";
-  css += ".btn-monitoring{background:#fd7e14}";
-  css += ".effect-btn{background:#17a2b8;margin:5px}";
-  css += ".effects-grid{display:flex;flex-wrap:wrap;gap:10px}";
-  css += "input[type='text'],input[type='password']{width:100%;padding:10px;margin:5px 0;border:1px solid #ddd;border-radius:5px;box-sizing:border-box}";
-  css += "input[type='color']{width:60px;height:40px;border:none;border-radius:5px;cursor:pointer}";
-  css += "label{font-weight:bold;margin-right:10px}";
-  css += ".networks{margin-top:10px}";
-  css += ".network-item{padding:10px;margin:5px 0;background:white;border-radius:5px;cursor:pointer;border:1px solid #ddd}";
-  css += ".network-item:hover{background:#e9ecef}";
-  css += ".status-grid{display:grid;grid-template-columns:repeat(auto-fit,minmax(200px,1fr));gap:10px}";
-  css += ".status-item{display:flex;justify-content:space-between;padding:10px;background:white;border-radius:5px}";
-  css += ".label{font-weight:bold;color:#666}";
-  css += ".value{color:#333}";
-  css += ".connected{color:#28a745!important;font-weight:bold}";
-  css += ".disconnected{color:#dc3545!important;font-weight:bold}";
-  css += "@media(max-width:600px){.container{padding:10px}.effects-grid{flex-direction:column}}";
-
-  server.send(200, "text/css", css);
+  unsigned long startMicros = micros();
+  bool wifiConnected = WiFi.status() == WL_CONNECTED;
+
+  page.begin("text/html");
+  page.print(PAGE_HEAD);
+  page.print(MONITORING_PAGE_TOP);
+  page.printf("<div class='status-item'><span class='label'>WiFi:</span><span id='wifi' class='value %s'>%s</span></div>",
+              wifiConnected ? "connected" : "disconnected", wifiConnected ? "Connected" : "Disconnected");
+  page.printf("<div class='status-item'><span class='label'>Network:</span><span class='value'>%s</span></div>",
+              provisionSSID);
+  IPAddress ip = WiFi.localIP();
+  page.printf("<div class='status-item'><span class='label'>IP Address:</span><span class='value'>%u.%u.%u.%u</span></div>",
+              ip[0], ip[1], ip[2], ip[3]);
+  page.printf("<div class='status-item'><span class='label'>Internet:</span><span id='internet' class='value %s'>%s</span></div>",
+              internetStatus ? "connected" : "disconnected",
+              internetState() == INTERNET_DEGRADED ? "Degraded" : internetStatus ? "Available" : "Not Available");
+  page.printf("<div class='status-item'><span class='label'>Signal:</span><span id='rssi' class='value'>%d dBm</span></div>",
+              WiFi.RSSI());
+  page.printf("<div class='status-item'><span class='label'>Probe Latency:</span><span id='latency' class='value'>%lu ms</span></div>",
+              lastProbeLatency);
+  page.printf("<div class='status-item'><span class='label'>Effect:</span><span id='effect' class='value'>%s</span></div>",
+              effectRegistry[currentEffect].name);
+  page.print(MONITORING_PAGE_EFFECTS);
+  streamEffectButtons(EFFECT_MENU_MONITORING);
+  page.print("<button onclick='returnToMonitoring()' class='btn btn-monitoring'>Return to Monitoring</button>");
+  streamEffectControls();
+  page.print(MONITORING_PAGE_BOTTOM);
+  page.end();
+
+  logResponseCost("/", startMicros);
+}
+
+void sendWebAsset(const WebAsset &asset)
+{
+  server.sendHeader("ETag", asset.etag);
+  server.sendHeader("Cache-Control", "public, max-age=3600");
+  if (server.header("If-None-Match") == asset.etag)
+  {
+    server.send(304);
+    return;
+  }
+
+  server.sendHeader("Content-Encoding", "gzip");
+  server.send_P(200, asset.contentType, (PGM_P)asset.data, asset.length);
 }
 
 void handleWiFiScan()
 {
-  String html = "";
-  int n = WiFi.scanNetworks();
+  // Answer from the cache right away, refresh it in the background when stale
+  if (!scanValid || millis() - scanTimestamp >= SCAN_CACHE_TTL)
+  {
+    startWiFiScan();
+  }
 
-  if (n == 0)
+  page.begin("application/json");
+  page.printf("{\"scanning\":%s,\"age_ms\":%lu,\"networks\":[",
+              scanRunning ? "true" : "false", scanValid ? millis() - scanTimestamp : 0);
+  for (uint8_t i = 0; i < scanResultCount; i++)
   {
-    html = "<p>No networks found</p>";
+    page.print(i == 0 ? "{\"ssid\":" : ",{\"ssid\":");
+    streamJsonString(scanResults[i].ssid);
+    page.printf(",\"rssi\":%d,\"secure\":%s}", scanResults[i].rssi, scanResults[i].secure ? "true" : "false");
   }
-  else
+  page.print("]}");
+  page.end();
+}
+
+void startWiFiScan()
+{
+  if (scanRunning)
+    return;
+
+  // Async mode returns immediately, checkWiFiScan() collects the results
+  if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED)
   {
-    html = "<div class='networks'>";
-    for (int i = 0; i < n; ++i)
+    Serial.println("WiFi scan failed to start");
+    return;
+  }
+  scanRunning = true;
+}
+
+void checkWiFiScan()
+{
+  if (!scanRunning)
+    return;
+
+  int16_t n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_RUNNING)
+    return;
+
+  scanRunning = false;
+  if (n < 0)
+  {
+    Serial.println("WiFi scan failed");
+    return;
+  }
+
+  scanResultCount = 0;
+  for (int16_t i = 0; i < n; i++)
+  {
+    addScanResult(WiFi.SSID(i).c_str(), WiFi.RSSI(i), WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
+  }
+  WiFi.scanDelete();
+
+  scanTimestamp = millis();
+  scanValid = true;
+  Serial.printf("WiFi scan: %d found, %u unique\n", n, scanResultCount);
+}
+
+void addScanResult(const char *ssid, int8_t rssi, bool secure)
+{
+  if (ssid[0] == '\0')
+    return; // Hidden network
+
+  // Same SSID from several access points: keep the strongest
+  for (uint8_t i = 0; i < scanResultCount; i++)
+  {
+    if (strcmp(scanResults[i].ssid, ssid) == 0)
     {
-      html += "<div class='network-item' onclick='selectNetwork(\"" + WiFi.SSID(i) + "\")'>";
-      html += "<strong>" + WiFi.SSID(i) + "</strong>";
-      html += " (" + String(WiFi.RSSI(i)) + " dBm)";
-      if (WiFi.encryptionType(i) != WIFI_AUTH_OPEN)
+      if (rssi > scanResults[i].rssi)
       {
-        html += " 🔒";
+        scanResults[i].rssi = rssi;
+        scanResults[i].secure = secure;
       }
-      html += "</div>";
+      return;
+    }
+  }
+
+  uint8_t slot = scanResultCount;
+  if (scanResultCount == MAX_SCAN_RESULTS)
+  {
+    // Cache full: replace the weakest entry if this one is stronger
+    slot = 0;
+    for (uint8_t i = 1; i < scanResultCount; i++)
+    {
+      if (scanResults[i].rssi < scanResults[slot].rssi)
+        slot = i;
     }
-    html += "</div>";
+    if (rssi <= scanResults[slot].rssi)
+      return;
+  }
+  else
+  {
+    scanResultCount++;
   }
 
-  server.send(200, "text/html", html);
+  strlcpy(scanResults[slot].ssid, ssid, sizeof(scanResults[slot].ssid));
+  scanResults[slot].rssi = rssi;
+  scanResults[slot].secure = secure;
+}
+
+void streamJsonString(const char *text)
+{
+  char escaped[8];
+  page.print("\"");
+  for (const char *c = text; *c; c++)
+  {
+    if (*c == '"' || *c == '\\')
+    {
+      escaped[0] = '\\';
+      escaped[1] = *c;
+      escaped[2] = '\0';
+    }
+    else if ((uint8_t)*c < 0x20)
+    {
+      snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+    }
+    else
+    {
+      escaped[0] = *c;
+      escaped[1] = '\0';
+    }
+    page.print(escaped);
+  }
+  page.print("\"");
 }
 
 void handleWiFiConnect()
@@ -472,91 +950,444 @@ void handleWiFiConnect()
   String ssid = server.arg("ssid");
   String password = server.arg("password");
 
-  if (ssid.length() == 0)
+  if (ssid.length() == 0 || ssid.length() >= sizeof(provisionSSID))
+  {
+    sendText(400, "SSID must be 1 to %u characters", (unsigned)sizeof(provisionSSID) - 1);
+    return;
+  }
+  if (password.length() >= sizeof(provisionPassword))
   {
-    server.send(400, "text/plain", "SSID is required");
+    sendText(400, "Password must be at most %u characters", (unsigned)sizeof(provisionPassword) - 1);
     return;
   }
+  if (provisionState == PROVISION_CONNECTING)
+  {
+    sendText(409, "A connection attempt is already in progress");
+    return;
+  }
+
+  Serial.printf("Attempting to connect to: %s\n", ssid.c_str());
+
+  // Keep the AP up so the portal can poll /connect/status
+  WiFi.mode(WIFI_AP_STA);
+  beginProvisioning(ssid.c_str(), password.c_str(), false);
+
+  server.sendHeader("Location", "/connect/status");
+  server.send_P(202, "application/json", "{\"state\":\"connecting\"}");
+}
 
-  Serial.println("Attempting to connect to: " + ssid);
+void handleWiFiConnectStatus()
+{
+  static const char *stateNames[] = {"idle", "connecting", "connected", "failed"};
+
+  page.begin("application/json");
+  page.printf("{\"state\":\"%s\",\"reason\":%u,\"ssid\":", stateNames[provisionState], wifiDisconnectReason);
+  streamJsonString(provisionSSID);
+  page.print("}");
+  page.end();
+}
 
-  // Try to connect
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid.c_str(), password.c_str());
+void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info)
+{
+  static bool hadIP = false;
 
-  // Wait for connection
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20)
+  // Runs on the WiFi event task, only hand flags over to loop()
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
   {
-    delay(500);
-    attempts++;
+    if (hadIP)
+      metrics.wifiReconnects++;
+    else
+      metrics.bootIpUs = micros();
+    hadIP = true;
+    wifiGotIP = true;
+    wakeSchedulerTask(provisioningTask);
   }
-
-  if (WiFi.status() == WL_CONNECTED)
+  else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
   {
-    // Save credentials
-    preferences.putString("ssid", ssid);
-    preferences.putString("password", password);
+    metrics.wifiDisconnects++;
+    wifiGotIP = false;
+    wifiDisconnectReason = info.wifi_sta_disconnected.reason;
+    wakeSchedulerTask(provisioningTask);
+  }
+}
 
-    server.send(200, "text/plain", "Success! Connected to " + ssid + ". Device will restart in monitoring mode.");
+void beginProvisioning(const char *ssid, const char *password, bool fromBoot)
+{
+  strlcpy(provisionSSID, ssid, sizeof(provisionSSID));
+  strlcpy(provisionPassword, password, sizeof(provisionPassword));
+  provisionFromBoot = fromBoot;
+  provisionStarted = millis();
+  provisionState = PROVISION_CONNECTING;
+  wifiGotIP = false;
+  wifiDisconnectReason = 0;
+
+  WiFi.begin(provisionSSID, provisionPassword);
+}
 
-    delay(2000);
+void updateProvisioning()
+{
+  if (restartAt != 0 && (long)(millis() - restartAt) >= 0)
+  {
+    flushSettings(preferences, true);
     ESP.restart();
   }
-  else
+
+  if (provisionState != PROVISION_CONNECTING)
+    return;
+
+  if (wifiGotIP)
   {
-    server.send(400, "text/plain", "Failed to connect to " + ssid + ". Please check credentials.");
-    // Restart AP mode
-    startFactoryMode();
+    provisionState = PROVISION_CONNECTED;
+    Serial.print("Connected to WiFi! IP address: ");
+    Serial.println(WiFi.localIP());
+
+    if (provisionFromBoot)
+    {
+      startMonitoringMode();
+    }
+    else
+    {
+      // Save credentials and give the portal time to see the result
+      preferences.putString("ssid", provisionSSID);
+      preferences.putString("password", provisionPassword);
+      scheduleRestart(2000);
+    }
+    memset(provisionPassword, 0, sizeof(provisionPassword));
+  }
+  else if (millis() - provisionStarted >= WIFI_CONNECT_TIMEOUT)
+  {
+    provisionState = PROVISION_FAILED;
+    memset(provisionPassword, 0, sizeof(provisionPassword));
+    WiFi.disconnect();
+    Serial.printf("Failed to connect to %s (reason %u)\n", provisionSSID, wifiDisconnectReason);
+
+    if (provisionFromBoot)
+    {
+      Serial.println("Starting factory mode.");
+      startFactoryMode();
+    }
+    else
+    {
+      WiFi.mode(WIFI_AP);
+    }
   }
 }
 
+void scheduleRestart(unsigned long delayMs)
+{
+  restartAt = millis() + delayMs;
+  if (restartAt == 0)
+    restartAt = 1;
+}
+
 void handleEffectChange()
 {
   String effect = server.arg("effect");
   String color = server.arg("color");
   String snakeColorArg = server.arg("snakeColor");
+  String fps = server.arg("fps");
 
-  currentEffect = effect;
-  if (color.length() > 0)
+  EffectId id = findEffect(effect.c_str());
+  if (id == EFFECT_NONE)
   {
-    staticColor = color;
+    sendText(400, "Unknown effect: %s", effect.c_str());
+    return;
   }
-  if (snakeColorArg.length() > 0)
+
+  // Validate both colors before changing anything
+  CRGB parsedStatic = effectSettings.staticColor;
+  CRGB parsedSnake = effectSettings.snakeColor;
+  if ((color.length() > 0 && !parseHexColor(color.c_str(), parsedStatic)) ||
+      (snakeColorArg.length() > 0 && !parseHexColor(snakeColorArg.c_str(), parsedSnake)))
+  {
+    sendText(400, "Invalid color, expected #RRGGBB");
+    return;
+  }
+  if (fps.length() > 0 && (fps.toInt() < 1 || fps.toInt() > MAX_FPS))
+  {
+    sendText(400, "fps must be between 1 and %d", MAX_FPS);
+    return;
+  }
+
+  currentEffect = id;
+  effectSettings.staticColor = parsedStatic;
+  effectSettings.snakeColor = parsedSnake;
+  if (fps.length() > 0)
   {
-    snakeColor = snakeColorArg;
+    targetFps = fps.toInt();
   }
+  postEffectCommand();
+  saveUserSettings();
 
-  Serial.println("Effect changed to: " + effect);
-  server.send(200, "text/plain", "Effect changed to " + effect);
+  Serial.printf("Effect changed to: %s\n", effectRegistry[id].name);
+  sendText(200, "Effect changed to %s", effectRegistry[id].name);
+}
+
+// JSON batch, e.g. {"effect":"static","color":"#FF8800","speed":150,"brightness":80}.
+// Every member is validated before anything changes, then the whole batch
+// goes to the render task as one command.
+void handleCommand()
+{
+  char body[MAX_COMMAND_SIZE];
+  String plain = server.arg("plain");
+  if (plain.length() >= sizeof(body))
+  {
+    sendText(413, "Command larger than %d bytes", MAX_COMMAND_SIZE - 1);
+    return;
+  }
+  memcpy(body, plain.c_str(), plain.length() + 1);
+
+  JsonField fields[MAX_COMMAND_FIELDS];
+  int count = parseJsonObject(body, fields, MAX_COMMAND_FIELDS);
+  if (count < 0)
+  {
+    sendText(400, "Expected a flat JSON object with at most %d members", MAX_COMMAND_FIELDS);
+    return;
+  }
+
+  // effect, start and length apply to segment 0 unless a segment is named
+  EffectId effect = EFFECT_NONE;
+  EffectSettings settings = effectSettings;
+  long fps = targetFps;
+  long brightness = ledBrightness;
+  long speed = effectSpeed;
+  long segment = -1;
+  long start = -1;
+  long length = -1;
+  for (int i = 0; i < count; i++)
+  {
+    const JsonField &field = fields[i];
+    bool valid;
+    if (strcmp(field.key, "effect") == 0)
+    {
+      effect = field.text != NULL ? findEffect(field.text) : EFFECT_NONE;
+      valid = effect != EFFECT_NONE;
+    }
+    else if (strcmp(field.key, "segment") == 0)
+    {
+      segment = field.number;
+      valid = field.text == NULL && segment >= 0 && segment < MAX_SEGMENTS;
+    }
+    else if (strcmp(field.key, "start") == 0)
+    {
+      start = field.number;
+      valid = field.text == NULL && start >= 0 && start < ledCount;
+    }
+    else if (strcmp(field.key, "length") == 0)
+    {
+      length = field.number;
+      valid = field.text == NULL && length >= 0 && length <= ledCount; // 0 removes the segment
+    }
+    else if (strcmp(field.key, "color") == 0)
+    {
+      valid = field.text != NULL && parseHexColor(field.text, settings.staticColor);
+    }
+    else if (strcmp(field.key, "snakeColor") == 0)
+    {
+      valid = field.text != NULL && parseHexColor(field.text, settings.snakeColor);
+    }
+    else if (strcmp(field.key, "fps") == 0)
+    {
+      fps = field.number;
+      valid = field.text == NULL && fps >= 1 && fps <= MAX_FPS;
+    }
+    else if (strcmp(field.key, "speed") == 0)
+    {
+      speed = field.number;
+      valid = field.text == NULL && speed >= MIN_SPEED && speed <= MAX_SPEED;
+    }
+    else if (strcmp(field.key, "brightness") == 0)
+    {
+      brightness = field.number;
+      valid = field.text == NULL && brightness >= 0 && brightness <= 255;
+    }
+    else
+    {
+      sendText(400, "Unknown member: %s", field.key);
+      return;
+    }
+
+    if (!valid)
+    {
+      sendText(400, "Invalid value for %s", field.key);
+      return;
+    }
+  }
+
+  Segment layout[MAX_SEGMENTS];
+  memcpy(layout, segments, sizeof(layout));
+  layout[0].effect = currentEffect;
+  Segment &target = layout[max<long>(segment, 0)];
+  if (segment > 0 && target.length == 0 && effect == EFFECT_NONE)
+  {
+    sendText(400, "New segments need an effect");
+    return;
+  }
+  if (start >= 0)
+    target.start = start;
+  if (length >= 0)
+    target.length = length;
+  if (effect != EFFECT_NONE)
+    target.effect = effect;
+  int invalid = findInvalidSegment(layout, ledCount);
+  if (invalid >= 0)
+  {
+    sendText(400, "Segment %d is empty, runs past the strip or overlaps another", invalid);
+    return;
+  }
+
+  memcpy(segments, layout, sizeof(segments));
+  currentEffect = layout[0].effect;
+  effectSettings = settings;
+  targetFps = fps;
+  ledBrightness = brightness;
+  effectSpeed = speed;
+  postEffectCommand();
+  saveUserSettings();
+
+  sendText(200, "Applied %d change(s)", count);
 }
 
 void handleFactoryResetWeb()
 {
+  discardSettings();
   preferences.clear();
-  server.send(200, "text/plain", "Factory reset initiated. Device will restart.");
-  delay(1000);
-  ESP.restart();
+  sendText(200, "Factory reset initiated. Device will restart.");
+  scheduleRestart(1000);
 }
 
 void handleMonitoringMode()
 {
-  currentEffect = "monitoring";
+  currentEffect = internetStatusEffect();
+  postEffectCommand();
+  saveUserSettings();
   Serial.println("Returned to monitoring mode");
-  server.send(200, "text/plain", "Returned to monitoring mode");
+  sendText(200, "Returned to monitoring mode");
 }
 
 void handleStatus()
 {
-  String json = "{";
-  json += "\"wifi_connected\":" + String(WiFi.status() == WL_CONNECTED ? "true" : "false") + ",";
-  json += "\"ssid\":\"" + WiFi.SSID() + "\",";
-  json += "\"ip\":\"" + WiFi.localIP().toString() + "\",";
-  json += "\"internet\":" + String(internetStatus ? "true" : "false") + ",";
-  json += "\"effect\":\"" + currentEffect + "\"";
-  json += "}";
+  IPAddress ip = WiFi.localIP();
+
+  page.begin("application/json");
+  page.printf("{\"wifi_connected\":%s,\"ssid\":", WiFi.status() == WL_CONNECTED ? "true" : "false");
+  streamJsonString(provisionSSID);
+  page.printf(",\"ip\":\"%u.%u.%u.%u\",\"internet\":%s,\"internet_state\":\"%s\",\"effect\":\"%s\",\"overlay\":\"%s\",",
+              ip[0], ip[1], ip[2], ip[3], internetStatus ? "true" : "false",
+              internetStateName(internetState()), effectRegistry[currentEffect].name, statusOverlayName(postedOverlay));
+
+  OutputStats output = outputStats();
+  page.printf("\"output\":{\"fps\":%.1f,\"show_us\":%u,\"show_max_us\":%u,\"frames\":%u,\"dropped\":%u}",
+              output.fps, output.showTimeUs, output.showTimeMaxUs, output.framesShown, output.framesDropped);
+  page.printf(",\"brightness\":%u,\"speed\":%u,\"segments\":[", ledBrightness, effectSpeed);
+  bool first = true;
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+  {
+    if (segments[i].length == 0)
+      continue;
+    page.printf("%s{\"segment\":%u,\"start\":%u,\"length\":%u,\"effect\":\"%s\"}", first ? "" : ",", i,
+                segments[i].start, segments[i].length, effectRegistry[segmentEffect(i)].name);
+    first = false;
+  }
+  page.print("]");
+  page.printf(",\"render\":{\"target_fps\":%u,\"compute_us\":%u,\"jitter_us\":%u,\"jitter_max_us\":%u,\"idle_waits\":%u}",
+              targetFps, renderStats.computeUs, renderStats.jitterUs, renderStats.jitterMaxUs, renderStats.idleWaits);
+  page.printf(",\"boot\":{\"first_frame_ms\":%u,\"ip_ms\":%u,\"first_probe_ms\":%u}",
+              metrics.bootFirstFrameUs / 1000, metrics.bootIpUs / 1000, metrics.bootFirstProbeUs / 1000);
+  page.print("}");
+  page.end();
+}
+
+void handleStripConfig()
+{
+  page.begin("application/json");
+  page.printf("{\"leds\":%d,\"strips\":[", ledCount);
+  for (uint8_t i = 0; i < stripCount; i++)
+  {
+    page.printf("%s{\"pin\":%u,\"length\":%u,\"order\":\"%s\"}", i == 0 ? "" : ",",
+                strips[i].pin, strips[i].length, stripColorOrderName(strips[i].colorOrder));
+  }
+  page.print("]}");
+  page.end();
+}
+
+void handleStripConfigSave()
+{
+  // Form fields: count, then pinN, lengthN and orderN for each strip
+  StripConfig config[MAX_STRIPS];
+  long count = server.arg("count").toInt();
+  if (count < 1 || count > MAX_STRIPS)
+  {
+    sendText(400, "count must be between 1 and %d", MAX_STRIPS);
+    return;
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    char pinKey[8];
+    char lengthKey[8];
+    char orderKey[8];
+    snprintf(pinKey, sizeof(pinKey), "pin%u", i);
+    snprintf(lengthKey, sizeof(lengthKey), "length%u", i);
+    snprintf(orderKey, sizeof(orderKey), "order%u", i);
+
+    long pin = server.arg(pinKey).toInt();
+    long length = server.arg(lengthKey).toInt();
+    int order = server.hasArg(orderKey) ? findStripColorOrder(server.arg(orderKey).c_str()) : STRIP_ORDER_GRB;
+    if (pin < 0 || pin > 255 || length < 1 || length > MAX_TOTAL_LEDS || order < 0)
+    {
+      sendText(400, "Invalid settings for strip %u", i);
+      return;
+    }
+    config[i].pin = pin;
+    config[i].length = length;
+    config[i].colorOrder = order;
+  }
 
-  server.send(200, "application/json", json);
+  if (!saveStripConfig(preferences, config, count))
+  {
+    sendText(400, "Invalid strip layout: check pins, duplicates and the total of %d LEDs", MAX_TOTAL_LEDS);
+    return;
+  }
+
+  // Frame buffers and controllers are set up once at boot
+  sendText(200, "Strip layout saved. Device will restart.");
+  scheduleRestart(1000);
+}
+
+void handleTimeline()
+{
+  page.begin("application/json");
+  page.printf("{\"steps\":%u,\"duration_ms\":%u,\"source\":\"%s\",\"max_steps\":%d}",
+              timelineStepCount(), timelineDuration(), timelineFromFlash() ? "flash" : "builtin", MAX_TIMELINE_STEPS);
+  page.end();
+}
+
+void handleTimelineUpload()
+{
+  // Multipart file upload, e.g. curl -F file=@show.bin http://<device>/timeline
+  HTTPUpload &upload = server.upload();
+  if (upload.status == UPLOAD_FILE_START)
+  {
+    beginTimelineUpload();
+  }
+  else if (upload.status == UPLOAD_FILE_WRITE)
+  {
+    writeTimelineUpload(upload.buf, upload.currentSize);
+  }
+}
+
+void handleTimelineUploadDone()
+{
+  TimelineStatus status = commitTimelineUpload();
+  if (status != TIMELINE_OK)
+  {
+    sendText(status == TIMELINE_BUSY ? 503 : 400, "%s", timelineStatusMessage(status));
+    return;
+  }
+
+  Serial.printf("Timeline stored: %u steps, %u ms\n", timelineStepCount(), timelineDuration());
+  sendText(200, "%s", timelineStatusMessage(status));
 }
 
 void checkFactoryReset()
@@ -571,6 +1402,7 @@ void checkFactoryReset()
     else if (millis() - factoryResetPressTime > 20)
     { // Hold for 3 seconds
       Serial.println("Factory reset button pressed!");
+      discardSettings();
       preferences.clear();
       ESP.restart();
     }
@@ -581,153 +1413,675 @@ void checkFactoryReset()
   }
 }
 
+void checkSerialCommands()
+{
+  static char command[16];
+  static uint8_t length = 0;
+
+  while (Serial.available())
+  {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r')
+    {
+      if (length < sizeof(command) - 1)
+        command[length++] = c;
+      continue;
+    }
+    if (length == 0)
+      continue;
+    command[length] = '\0';
+    length = 0;
+
+    if (strcmp(command, "bench") == 0)
+    {
+      // The render task owns the effect state, so it runs the benchmark between frames
+      Serial.println("Running effect benchmark...");
+      benchmarkRequested = true;
+    }
+    else
+    {
+      Serial.printf("Unknown command: %s\n", command);
+    }
+  }
+}
+
 void checkInternetConnection()
 {
-  HTTPClient http;
-  http.begin("http://clients3.google.com/generate_204");
-  http.setTimeout(3000); // трохи менший таймаут
-  int httpCode = http.GET();
-  bool wasConnected = internetStatus;
-  internetStatus = (httpCode == 204);
-  http.end();
+  ProbeResult result;
+  if (!pollProbeResult(result))
+    return; // No finished probe yet
 
-  Serial.printf("Internet check: %s (code=%d)\n", internetStatus ? "Connected" : "Disconnected", httpCode);
+  lastInternetCheck = millis();
+  lastProbeLatency = result.totalMs;
+  if (metrics.bootFirstProbeUs == 0)
+  {
+    metrics.bootFirstProbeUs = micros();
+    Serial.printf("Boot: first frame %u ms, IP %u ms, first probe %u ms\n", metrics.bootFirstFrameUs / 1000,
+                  metrics.bootIpUs / 1000, metrics.bootFirstProbeUs / 1000);
+  }
+  if (result.success)
+  {
+    metrics.probeSuccesses++;
+    metrics.probeLatencySumMs += result.totalMs;
+  }
+  else
+  {
+    metrics.probeFailures++;
+  }
 
-  if (deviceMode == "monitoring" && (currentEffect == "monitoring" || currentEffect == "breathe_green" || currentEffect == "blink_red"))
+  // The probe module applies hysteresis, a single failure does not flip the state
+  InternetState state = internetState();
+  internetStatus = state == INTERNET_ONLINE || state == INTERNET_DEGRADED;
+
+  Serial.printf("Internet check: %s via %s (status=%d, dns %u ms, connect %u ms, first byte %u ms)\n",
+                internetStateName(state), probeTargetAt(result.target).host, result.status,
+                result.dnsMs, result.connectMs, result.firstByteMs);
+
+  if (deviceMode != MODE_MONITORING)
+    return;
+
+  // Status effects follow the state directly, user effects get an overlay
+  bool effectChanged = false;
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
   {
-    currentEffect = internetStatus ? "breathe_green" : "blink_red";
+    if (segments[i].length == 0)
+      continue;
+    EffectId &effect = i == 0 ? currentEffect : segments[i].effect;
+    EffectId nextEffect = statusEffect(effect, internetStatus, state == INTERNET_DEGRADED);
+    effectChanged |= nextEffect != effect;
+    effect = nextEffect;
+  }
+  if (effectChanged || currentStatusOverlay() != postedOverlay)
+  {
+    postEffectCommand();
   }
 }
 
-void updateLEDEffects()
+void handleProbes()
 {
-  unsigned long currentTime = millis();
+  page.begin("application/json");
+  page.printf("{\"state\":\"%s\",\"targets\":[", internetStateName(internetState()));
+  for (uint8_t i = 0; i < probeTargetCount(); i++)
+  {
+    const ProbeTarget &target = probeTargetAt(i);
+    page.printf("%s\"%s:%u%s\"", i == 0 ? "" : ",", target.host, target.port, target.path);
+  }
 
-  if (currentTime - lastEffectUpdate < 50)
-    return; // Update at ~20 FPS
-  lastEffectUpdate = currentTime;
+  page.print("],\"histogram\":[");
+  const uint32_t *histogram = probeHistogram();
+  for (uint8_t i = 0; i < PROBE_HISTOGRAM_BUCKETS; i++)
+  {
+    if (i < PROBE_HISTOGRAM_BUCKETS - 1)
+      page.printf("%s{\"le\":%u,\"count\":%u}", i == 0 ? "" : ",", probeHistogramBounds[i], histogram[i]);
+    else
+      page.printf(",{\"le\":null,\"count\":%u}", histogram[i]);
+  }
 
-  if (currentEffect == "rainbow")
+  // Compact history, newest first: [age_ms, target, status, dns, connect, first_byte, total]
+  page.print("],\"history\":[");
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < probeHistoryCount(); i++)
   {
-    effectRainbow();
+    const ProbeResult &result = probeHistoryAt(i);
+    page.printf("%s[%u,%u,%d,%u,%u,%u,%u]", i == 0 ? "" : ",", now - result.timestamp, result.target,
+                result.status, result.dnsMs, result.connectMs, result.firstByteMs, result.totalMs);
   }
-  else if (currentEffect == "fill_rainbow")
+  page.print("]}");
+  page.end();
+}
+
+void handleProbeTargets()
+{
+  // Comma separated host[:port]/path list, e.g. a local stand-in "192.168.1.10:8080/generate_204"
+  if (!setProbeTargets(preferences, server.arg("targets").c_str()))
   {
-    effectFillRainbow();
+    sendText(400, "Invalid targets, expected host[:port]/path[,...] with at most %d entries", MAX_PROBE_TARGETS);
+    return;
   }
-  else if (currentEffect == "static")
+  sendText(200, "Probe targets updated");
+}
+
+// Prometheus text exposition format, streamed through the fixed page buffer
+void handleMetrics()
+{
+  page.begin("text/plain; version=0.0.4");
+
+  streamTimingMetric("wifimon_loop_duration", "Main loop scheduler pass time", metrics.loop);
+  streamTimingMetric("wifimon_frame_compute", "Effect render time per frame", metrics.frameCompute);
+
+  OutputStats output = outputStats();
+  TimingMetric show = {output.framesShown, output.showTimeTotalUs, output.showTimeMaxUs};
+  streamTimingMetric("wifimon_led_show", "FastLED.show() time per frame", show);
+  page.printf("# HELP wifimon_frames_dropped_total Frames finished while the previous one was still being sent\n"
+              "# TYPE wifimon_frames_dropped_total counter\n"
+              "wifimon_frames_dropped_total %u\n",
+              output.framesDropped);
+  page.printf("# HELP wifimon_output_fps Frames shown during the last second\n"
+              "# TYPE wifimon_output_fps gauge\n"
+              "wifimon_output_fps %.1f\n",
+              output.fps);
+
+  page.print("# HELP wifimon_probes_total Finished internet probes\n"
+             "# TYPE wifimon_probes_total counter\n");
+  page.printf("wifimon_probes_total{result=\"success\"} %u\n", metrics.probeSuccesses);
+  page.printf("wifimon_probes_total{result=\"failure\"} %u\n", metrics.probeFailures);
+
+  // The probe module keeps per-bucket counts, Prometheus wants them cumulative
+  page.print("# HELP wifimon_probe_latency_seconds Total time of successful probes\n"
+             "# TYPE wifimon_probe_latency_seconds histogram\n");
+  const uint32_t *histogram = probeHistogram();
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < PROBE_HISTOGRAM_BUCKETS; i++)
+  {
+    cumulative += histogram[i];
+    if (i < PROBE_HISTOGRAM_BUCKETS - 1)
+      page.printf("wifimon_probe_latency_seconds_bucket{le=\"%.3f\"} %u\n", probeHistogramBounds[i] / 1000.0, cumulative);
+    else
+      page.printf("wifimon_probe_latency_seconds_bucket{le=\"+Inf\"} %u\n", cumulative);
+  }
+  page.printf("wifimon_probe_latency_seconds_sum %.3f\n", metrics.probeLatencySumMs / 1000.0);
+  page.printf("wifimon_probe_latency_seconds_count %u\n", cumulative);
+
+  page.print("# HELP wifimon_internet_state Current internet state\n"
+             "# TYPE wifimon_internet_state gauge\n");
+  for (uint8_t i = INTERNET_UNKNOWN; i <= INTERNET_ONLINE; i++)
   {
-    effectStatic();
+    page.printf("wifimon_internet_state{state=\"%s\"} %d\n", internetStateName((InternetState)i), internetState() == i);
   }
-  else if (currentEffect == "snake")
+
+  page.print("# HELP wifimon_http_requests_total Requests handled per route\n"
+             "# TYPE wifimon_http_requests_total counter\n");
+  for (uint8_t i = 0; i < routeMetricCount(); i++)
+  {
+    const RouteMetric &route = routeMetricAt(i);
+    page.printf("wifimon_http_requests_total{method=\"%s\",path=\"%s\"} %u\n",
+                httpMethodName(route.method), route.path, route.timing.count);
+  }
+  page.print("# HELP wifimon_http_handler_seconds Handler time per route\n"
+             "# TYPE wifimon_http_handler_seconds summary\n");
+  for (uint8_t i = 0; i < routeMetricCount(); i++)
   {
-    effectSnake();
+    const RouteMetric &route = routeMetricAt(i);
+    page.printf("wifimon_http_handler_seconds_sum{method=\"%s\",path=\"%s\"} %.6f\n",
+                httpMethodName(route.method), route.path, route.timing.sumUs / 1e6);
+    page.printf("wifimon_http_handler_seconds_count{method=\"%s\",path=\"%s\"} %u\n",
+                httpMethodName(route.method), route.path, route.timing.count);
   }
-  else if (currentEffect == "waiting")
+
+  const CaptiveDnsStats &dns = captiveDnsStats();
+  page.printf("# HELP wifimon_dns_queries_total Captive portal DNS queries received\n"
+              "# TYPE wifimon_dns_queries_total counter\n"
+              "wifimon_dns_queries_total %u\n",
+              dns.queries);
+  page.printf("# HELP wifimon_dns_cache_hits_total Queries answered from the response cache\n"
+              "# TYPE wifimon_dns_cache_hits_total counter\n"
+              "wifimon_dns_cache_hits_total %u\n",
+              dns.cacheHits);
+  page.printf("# HELP wifimon_dns_dropped_total Queries dropped without a reply\n"
+              "# TYPE wifimon_dns_dropped_total counter\n"
+              "wifimon_dns_dropped_total{reason=\"rate_limited\"} %u\n"
+              "wifimon_dns_dropped_total{reason=\"malformed\"} %u\n",
+              dns.rateLimited, dns.malformed);
+
+  page.printf("# HELP wifimon_event_clients_dropped_total Live status subscribers dropped for not keeping up\n"
+              "# TYPE wifimon_event_clients_dropped_total counter\n"
+              "wifimon_event_clients_dropped_total %u\n",
+              metrics.eventClientsDropped);
+
+  page.print("# HELP wifimon_task_run_seconds Run time per loop task\n"
+             "# TYPE wifimon_task_run_seconds summary\n");
+  for (uint8_t i = 0; i < schedulerTaskCount(); i++)
   {
-    effectWaiting();
+    const SchedulerTask &task = schedulerTaskAt(i);
+    page.printf("wifimon_task_run_seconds_sum{task=\"%s\"} %.6f\n", task.name, task.runTimeUs / 1e6);
+    page.printf("wifimon_task_run_seconds_count{task=\"%s\"} %u\n", task.name, task.runs);
   }
-  else if (currentEffect == "breathe_green" || currentEffect == "monitoring")
+  page.print("# HELP wifimon_task_run_max_seconds Longest single run per loop task\n"
+             "# TYPE wifimon_task_run_max_seconds gauge\n");
+  for (uint8_t i = 0; i < schedulerTaskCount(); i++)
   {
-    effectBreatheGreen();
+    const SchedulerTask &task = schedulerTaskAt(i);
+    page.printf("wifimon_task_run_max_seconds{task=\"%s\"} %.6f\n", task.name, task.maxRunUs / 1e6);
   }
-  else if (currentEffect == "blink_red")
+  page.print("# HELP wifimon_task_late_max_seconds Worst start delay past a loop task's deadline\n"
+             "# TYPE wifimon_task_late_max_seconds gauge\n");
+  for (uint8_t i = 0; i < schedulerTaskCount(); i++)
   {
-    effectBlinkRed();
+    const SchedulerTask &task = schedulerTaskAt(i);
+    page.printf("wifimon_task_late_max_seconds{task=\"%s\"} %.6f\n", task.name, task.maxLateUs / 1e6);
+  }
+  page.print("# HELP wifimon_task_overruns_total Loop task runs over their time budget\n"
+             "# TYPE wifimon_task_overruns_total counter\n");
+  for (uint8_t i = 0; i < schedulerTaskCount(); i++)
+  {
+    const SchedulerTask &task = schedulerTaskAt(i);
+    page.printf("wifimon_task_overruns_total{task=\"%s\"} %u\n", task.name, task.overruns);
   }
 
-  FastLED.show();
+  page.printf("# HELP wifimon_heap_free_bytes Free heap\n"
+              "# TYPE wifimon_heap_free_bytes gauge\n"
+              "wifimon_heap_free_bytes %u\n",
+              ESP.getFreeHeap());
+  page.printf("# HELP wifimon_heap_min_free_bytes Lowest free heap since boot\n"
+              "# TYPE wifimon_heap_min_free_bytes gauge\n"
+              "wifimon_heap_min_free_bytes %u\n",
+              ESP.getMinFreeHeap());
+  page.printf("# HELP wifimon_heap_largest_block_bytes Largest allocatable block, low values mean fragmentation\n"
+              "# TYPE wifimon_heap_largest_block_bytes gauge\n"
+              "wifimon_heap_largest_block_bytes %u\n",
+              ESP.getMaxAllocHeap());
+
+  page.printf("# HELP wifimon_wifi_rssi_dbm Signal strength\n"
+              "# TYPE wifimon_wifi_rssi_dbm gauge\n"
+              "wifimon_wifi_rssi_dbm %d\n",
+              WiFi.RSSI());
+  page.printf("# HELP wifimon_wifi_disconnects_total Station disconnect events\n"
+              "# TYPE wifimon_wifi_disconnects_total counter\n"
+              "wifimon_wifi_disconnects_total %u\n",
+              metrics.wifiDisconnects);
+  page.printf("# HELP wifimon_wifi_reconnects_total IP acquired again after a disconnect\n"
+              "# TYPE wifimon_wifi_reconnects_total counter\n"
+              "wifimon_wifi_reconnects_total %u\n",
+              metrics.wifiReconnects);
+
+  page.printf("# HELP wifimon_settings_flash_writes_total Settings blobs written to NVS\n"
+              "# TYPE wifimon_settings_flash_writes_total counter\n"
+              "wifimon_settings_flash_writes_total %u\n",
+              settingsFlashWrites());
+
+  // Phases not reached yet are left out rather than reported as 0
+  const char *bootPhases[] = {"first_frame", "ip", "first_probe"};
+  uint32_t bootTimes[] = {metrics.bootFirstFrameUs, metrics.bootIpUs, metrics.bootFirstProbeUs};
+  page.print("# HELP wifimon_boot_phase_seconds Time from reset until each boot phase was reached\n"
+             "# TYPE wifimon_boot_phase_seconds gauge\n");
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    if (bootTimes[i] != 0)
+      page.printf("wifimon_boot_phase_seconds{phase=\"%s\"} %.3f\n", bootPhases[i], bootTimes[i] / 1e6);
+  }
+  page.printf("# HELP wifimon_uptime_seconds Time since boot\n"
+              "# TYPE wifimon_uptime_seconds counter\n"
+              "wifimon_uptime_seconds %lu\n",
+              millis() / 1000);
+  page.end();
+}
+
+void streamTimingMetric(const char *name, const char *help, const TimingMetric &metric)
+{
+  page.printf("# HELP %s_seconds %s\n"
+              "# TYPE %s_seconds summary\n"
+              "%s_seconds_sum %.6f\n"
+              "%s_seconds_count %u\n",
+              name, help, name, name, metric.sumUs / 1e6, name, metric.count);
+  page.printf("# HELP %s_max_seconds %s, worst case\n"
+              "# TYPE %s_max_seconds gauge\n"
+              "%s_max_seconds %.6f\n",
+              name, help, name, name, metric.maxUs / 1e6);
 }
 
-void effectRainbow()
+void acceptEventClients()
 {
-  for (int i = 0; i < NUM_LEDS; i++)
+  WiFiClient client = eventServer.available();
+  if (!client)
+    return;
+
+  for (int i = 0; i < MAX_EVENT_CLIENTS; i++)
   {
-    leds[i] = CHSV((effectHue + i * 255 / NUM_LEDS) % 255, 255, 255);
+    if (!eventClients[i].connected())
+    {
+      // The request itself is not inspected, every connection is a subscription
+      client.print("HTTP/1.1 200 OK\r\n"
+                   "Content-Type: text/event-stream\r\n"
+                   "Cache-Control: no-cache\r\n"
+                   "Access-Control-Allow-Origin: *\r\n"
+                   "Connection: keep-alive\r\n\r\n");
+
+      char event[192];
+      formatLiveStatus(publishedStatus, event, sizeof(event));
+      client.print(event);
+      eventClients[i] = client;
+      return;
+    }
   }
-  effectHue += 2;
+
+  client.print("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+  client.stop();
 }
 
-void effectFillRainbow()
+void publishLiveStatus()
 {
-  fill_rainbow(leds, NUM_LEDS, effectHue, 7);
-  effectHue += 2;
+  unsigned long now = millis();
+
+  // Drain whatever subscribers send so their sockets don't fill up
+  for (int i = 0; i < MAX_EVENT_CLIENTS; i++)
+  {
+    while (eventClients[i].available())
+    {
+      eventClients[i].read();
+    }
+  }
+
+  LiveStatus status;
+  status.wifiConnected = WiFi.status() == WL_CONNECTED;
+  status.internet = internetStatus;
+  status.internetState = internetState();
+  status.effect = currentEffect;
+  status.rssi = WiFi.RSSI();
+  status.latencyMs = lastProbeLatency;
+
+  // RSSI jitters by a dB or two all the time, only report real moves
+  bool changed = status.wifiConnected != publishedStatus.wifiConnected ||
+                 status.internet != publishedStatus.internet ||
+                 status.internetState != publishedStatus.internetState ||
+                 status.effect != publishedStatus.effect ||
+                 abs(status.rssi - publishedStatus.rssi) >= 3 ||
+                 status.latencyMs != publishedStatus.latencyMs;
+
+  const char *message = NULL;
+  char event[192];
+  if (changed)
+  {
+    publishedStatus = status;
+    formatLiveStatus(status, event, sizeof(event));
+    message = event;
+  }
+  else if (now - lastEventsKeepalive >= EVENTS_KEEPALIVE)
+  {
+    message = ": keepalive\n\n"; // Lets dead subscribers be detected
+  }
+
+  if (message == NULL)
+    return;
+  lastEventsKeepalive = now;
+
+  for (int i = 0; i < MAX_EVENT_CLIENTS; i++)
+  {
+    if (eventClients[i].connected() && !sendEvent(eventClients[i], message))
+    {
+      // Its socket buffer is still full from earlier events. It reconnects
+      // and gets the current status, instead of stalling loop().
+      eventClients[i].stop();
+      metrics.eventClientsDropped++;
+    }
+  }
 }
 
-void effectStatic()
+// WiFiClient::print() waits and retries while the socket buffer is full,
+// which holds up loop() for seconds behind one slow subscriber. This sends
+// without waiting and fails unless the whole event fits, since half an
+// event would garble the stream anyway.
+bool sendEvent(WiFiClient &client, const char *message)
 {
-  // Convert hex color to RGB
-  long color = strtol(staticColor.substring(1).c_str(), NULL, 16);
-  uint8_t r = (color >> 16) & 0xFF;
-  uint8_t g = (color >> 8) & 0xFF;
-  uint8_t b = color & 0xFF;
+  size_t length = strlen(message);
+  return send(client.fd(), message, length, MSG_DONTWAIT) == (ssize_t)length;
+}
 
-  fill_solid(leds, NUM_LEDS, CRGB(r, g, b));
+void formatLiveStatus(const LiveStatus &status, char *buffer, size_t size)
+{
+  snprintf(buffer, size,
+           "data: {\"wifi_connected\":%s,\"internet\":%s,\"internet_state\":\"%s\",\"effect\":\"%s\",\"rssi\":%d,\"latency_ms\":%lu}\n\n",
+           status.wifiConnected ? "true" : "false", status.internet ? "true" : "false",
+           internetStateName(status.internetState), effectRegistry[status.effect].name, status.rssi, status.latencyMs);
 }
 
-void effectSnake()
+void postEffectCommand()
 {
-  fadeToBlackBy(leds, NUM_LEDS, 50);
+  EffectCommand command;
+  memcpy(command.segments, segments, sizeof(segments));
+  command.segments[0].effect = currentEffect;
+  command.settings = effectSettings;
+  command.fps = targetFps;
+  command.brightness = ledBrightness;
+  command.speed = effectSpeed;
+  command.overlay = currentStatusOverlay();
+  postedOverlay = command.overlay;
+
+  // Single-slot queue: the render task only ever needs the latest state
+  xQueueOverwrite(effectCommandQueue, &command);
+}
 
-  // Convert hex color to RGB for snake
-  long color = strtol(snakeColor.substring(1).c_str(), NULL, 16);
-  uint8_t r = (color >> 16) & 0xFF;
-  uint8_t g = (color >> 8) & 0xFF;
-  uint8_t b = color & 0xFF;
+void restoreSettings()
+{
+  DeviceSettings saved;
+  memcpy(saved.segments, segments, sizeof(segments)); // Kept by version 1 blobs
+  if (!loadSettings(preferences, saved))
+    return; // Nothing stored yet, keep the defaults
+
+  // A layout that no longer fits the strip falls back to one full-length segment
+  if (findInvalidSegment(saved.segments, ledCount) < 0)
+    memcpy(segments, saved.segments, sizeof(segments));
+
+  if (saved.effect < EFFECT_COUNT)
+    savedEffect = (EffectId)saved.effect;
+  if (saved.fps >= 1 && saved.fps <= MAX_FPS)
+    targetFps = saved.fps;
+  if (saved.speed >= MIN_SPEED && saved.speed <= MAX_SPEED)
+    effectSpeed = saved.speed;
+  ledBrightness = saved.brightness;
+  effectSettings.staticColor = saved.staticColor;
+  effectSettings.snakeColor = saved.snakeColor;
+}
 
-  leds[snakePosition] = CRGB(r, g, b);
+// Called for changes made by the user, not for effects switched by the internet check
+void saveUserSettings()
+{
+  savedEffect = currentEffect;
+
+  DeviceSettings settings;
+  settings.effect = currentEffect;
+  settings.fps = targetFps;
+  settings.brightness = ledBrightness;
+  settings.speed = effectSpeed;
+  settings.staticColor = effectSettings.staticColor;
+  settings.snakeColor = effectSettings.snakeColor;
+  memcpy(settings.segments, segments, sizeof(segments));
+  settings.segments[0].effect = currentEffect;
+  updateSettings(settings);
+}
 
-  snakePosition += snakeDirection;
-  if (snakePosition >= NUM_LEDS - 1 || snakePosition <= 0)
-  {
-    snakeDirection *= -1;
-  }
+// The saved effect, unless it is one the internet check would replace anyway.
+// At boot no probe has finished yet, so that is the checking effect, not green.
+EffectId monitoringEffect()
+{
+  return (effectRegistry[savedEffect].flags & EFFECT_STATUS) ? internetStatusEffect() : savedEffect;
+}
+
+// Status effect for what the probes have found so far
+EffectId internetStatusEffect()
+{
+  InternetState state = internetState();
+  if (state == INTERNET_UNKNOWN)
+    return EFFECT_CHECKING;
+  return statusEffect(EFFECT_BREATHE_GREEN, internetStatus, state == INTERNET_DEGRADED);
+}
+
+EffectId segmentEffect(uint8_t index)
+{
+  return index == 0 ? currentEffect : segments[index].effect;
 }
 
-void effectWaiting()
+StatusOverlay currentStatusOverlay()
 {
-  // Soft rainbow wave
-  for (int i = 0; i < NUM_LEDS; i++)
+  InternetState state = internetState();
+  if (deviceMode != MODE_MONITORING || state == INTERNET_UNKNOWN)
+    return OVERLAY_NONE;
+
+  bool statusShown = false;
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
   {
-    uint8_t brightness = beatsin8(20, 100, 255, 0, i * 10);
-    leds[i] = CHSV((effectHue + i * 20) % 255, 200, brightness);
+    if (segments[i].length != 0 && (effectRegistry[segmentEffect(i)].flags & EFFECT_STATUS))
+      statusShown = true;
   }
-  effectHue += 1;
+  return statusOverlay(statusShown, internetStatus, state == INTERNET_DEGRADED);
 }
 
-void effectBreatheGreen()
+void renderTask(void *param)
 {
-  // інвертуємо лише при виході за межі
-  if (breatheBrightness >= 255)
+  uint32_t lastFrameUs = micros();
+  uint32_t deadlineUs = lastFrameUs;
+  uint64_t effectClockUs = 0; // Runs at the effect speed, not wall time
+
+  for (;;)
   {
-    breatheDirection = -1;
+    // Sleep until the next frame is due or a command arrives. Still effects
+    // have no deadline, they only redraw when their settings change.
+    bool still = !frameDirty && segmentsStill(renderState.segments) && renderState.overlay == OVERLAY_NONE;
+    TickType_t wait = pdMS_TO_TICKS(STILL_FRAME_WAIT);
+    if (!still)
+    {
+      int32_t remainingUs = deadlineUs - micros();
+      wait = remainingUs > 0 ? pdMS_TO_TICKS((remainingUs + 999) / 1000) : 0;
+    }
+
+    EffectCommand command;
+    bool commanded = xQueueReceive(effectCommandQueue, &command, wait) == pdTRUE;
+    acceptTimeline();
+    if (commanded)
+    {
+      applyEffectCommand(command);
+      FastLED.setBrightness(renderState.brightness);
+
+      // Coalesce bursts, e.g. a dragged color picker: changes wait for the
+      // next frame boundary, where only the latest command counts
+      uint32_t dueUs = lastFrameUs + 1000000UL / max<uint8_t>(renderState.fps, 1);
+      if ((int32_t)(dueUs - micros()) > 0)
+      {
+        deadlineUs = dueUs;
+        continue;
+      }
+    }
+    if (benchmarkRequested)
+    {
+      runEffectBenchmark(Serial);
+      benchmarkRequested = false;
+      frameDirty = true;
+    }
+    if (!frameDirty && segmentsStill(renderState.segments) && renderState.overlay == OVERLAY_NONE)
+    {
+      renderStats.idleWaits++;
+      continue;
+    }
+
+    uint32_t periodUs = 1000000UL / max<uint8_t>(renderState.fps, 1);
+    uint32_t startUs = micros();
+    uint32_t intervalUs = startUs - lastFrameUs;
+
+    // Jitter only means something for frames that were due on schedule
+    if (!commanded && !still)
+    {
+      uint32_t deviation = intervalUs > periodUs ? intervalUs - periodUs : periodUs - intervalUs;
+      renderStats.jitterUs = (renderStats.jitterUs * 15 + deviation) / 16;
+      if (deviation > renderStats.jitterMaxUs)
+        renderStats.jitterMaxUs = deviation;
+    }
+
+    lastFrameUs = startUs;
+    uint32_t effectIntervalUs = (uint64_t)intervalUs * renderState.speed / 100;
+    effectClockUs += effectIntervalUs;
+    updateLEDEffects(effectClockUs / 1000, effectIntervalUs / 1000);
+    renderStats.computeUs = micros() - startUs;
+    renderStats.frames++;
+
+    // Next deadline stays on the fixed grid unless we fell a whole frame behind
+    deadlineUs += periodUs;
+    if ((int32_t)(startUs - deadlineUs) >= 0 || commanded)
+    {
+      deadlineUs = startUs + periodUs;
+    }
   }
-  else if (breatheBrightness <= 50)
+}
+
+// Render task only. Segments whose range or effect changed restart their
+// animation, still segments are only drawn again when their inputs change.
+void applyEffectCommand(const EffectCommand &command)
+{
+  bool settingsChanged = memcmp(&command.settings, &renderState.settings, sizeof(EffectSettings)) != 0;
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
   {
-    breatheDirection = 1;
+    const Segment &next = command.segments[i];
+    const Segment &shown = renderState.segments[i];
+    bool moved = next.start != shown.start || next.length != shown.length;
+    if (moved || next.effect != shown.effect)
+      memset(&segmentStates[i], 0, sizeof(EffectState));
+    if (moved || next.effect != shown.effect || settingsChanged)
+      segmentsDirty |= 1 << i;
+    layoutChanged |= moved;
   }
-  breatheBrightness += breatheDirection * 3;
-  fill_solid(leds, NUM_LEDS, CHSV(96, 255, breatheBrightness));
+  renderState = command;
+  frameDirty = true;
 }
 
-void effectBlinkRed()
+// now and elapsed are on the effect clock, the overlay keeps wall time
+void updateLEDEffects(uint32_t now, uint32_t elapsed)
 {
-  static bool blinkState = false;
-  static unsigned long lastBlink = 0;
-  unsigned long currentTime = millis();
-
-  if (currentTime - lastBlink > 250)
-  { // Blink every 250ms
-    blinkState = !blinkState;
-    lastBlink = currentTime;
+  if (layoutChanged)
+  {
+    fill_solid(baseLayer(), ledCount, CRGB::Black); // Pixels no segment covers any more
+    segmentsDirty = 0xFF;
+    layoutChanged = false;
   }
 
-  if (blinkState)
+  // The base layer keeps its pixels, so a still segment next to animated
+  // ones or under an animated overlay is skipped until its inputs change
+  if (segmentsDirty || !segmentsStill(renderState.segments))
   {
-    fill_solid(leds, NUM_LEDS, CRGB::Red);
+    uint32_t start = micros();
+    renderSegments(baseLayer(), ledCount, renderState.segments, segmentStates, segmentsDirty, now, elapsed,
+                   renderState.settings);
+    recordTiming(metrics.frameCompute, micros() - start);
   }
-  else
+  segmentsDirty = 0; // Drawn into the base layer, which keeps them even if the frame is dropped
+
+  composeFrame(backBuffer(), ledCount, renderState.overlay, millis());
+  if (!presentFrame())
+    return; // Still dirty, so a still frame is sent again on the next deadline
+  frameDirty = false;
+  if (metrics.bootFirstFrameUs == 0)
+    metrics.bootFirstFrameUs = micros();
+}
+
+void streamEffectButtons(uint8_t menu)
+{
+  for (uint8_t i = 0; i < EFFECT_COUNT; i++)
   {
-    fill_solid(leds, NUM_LEDS, CRGB::Black);
+    if (effectRegistry[i].flags & menu)
+    {
+      page.printf("<button onclick='setEffect(\"%s\")' class='btn effect-btn'>%s</button>",
+                  effectRegistry[i].name, effectRegistry[i].label);
+    }
   }
 }
+
+void streamEffectControls()
+{
+  char staticHex[8];
+  char snakeHex[8];
+  formatHexColor(effectSettings.staticColor, staticHex);
+  formatHexColor(effectSettings.snakeColor, snakeHex);
+  // Each template goes out in one page.printf(), with room for its values
+  static_assert(sizeof(STATIC_COLOR_CONTROL) + 8 < PAGE_CHUNK_SIZE, "split STATIC_COLOR_CONTROL");
+  static_assert(sizeof(SNAKE_COLOR_CONTROL) + 8 < PAGE_CHUNK_SIZE, "split SNAKE_COLOR_CONTROL");
+  static_assert(sizeof(SPEED_CONTROL) + 3 * 11 < PAGE_CHUNK_SIZE, "split SPEED_CONTROL");
+  static_assert(sizeof(BRIGHTNESS_CONTROL) + 11 < PAGE_CHUNK_SIZE, "split BRIGHTNESS_CONTROL");
+  page.printf(STATIC_COLOR_CONTROL, staticHex);
+  page.printf(SNAKE_COLOR_CONTROL, snakeHex);
+  page.printf(SPEED_CONTROL, MIN_SPEED, MAX_SPEED, effectSpeed);
+  page.printf(BRIGHTNESS_CONTROL, ledBrightness);
+}
+
+// Plain text response formatted into a fixed buffer instead of String temporaries
+void sendText(int code, const char *format, ...)
+{
+  char message[160];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  server.send_P(code, "text/plain", message, min<size_t>(length, sizeof(message) - 1));
+}
+
+void logResponseCost(const char *route, unsigned long startMicros)
+{
+  Serial.printf("GET %s: %lu us, free heap %u, min free heap %u\n",
+                route, micros() - startMicros, ESP.getFreeHeap(), ESP.getMinFreeHeap());
+}
@@ -0,0 +1,45 @@
+#include "metrics.h"
+
+Metrics metrics;
+
+static RouteMetric routes[MAX_ROUTE_METRICS];
+static uint8_t routeCount = 0;
+
+RouteMetric *addRouteMetric(const char *path, HTTPMethod method)
+{
+  if (routeCount == MAX_ROUTE_METRICS)
+    return NULL;
+
+  RouteMetric &route = routes[routeCount++];
+  route.path = path;
+  route.method = method;
+  route.timing = {0, 0, 0};
+  return &route;
+}
+
+uint8_t routeMetricCount()
+{
+  return routeCount;
+}
+
+const RouteMetric &routeMetricAt(uint8_t index)
+{
+  return routes[index];
+}
+
+const char *httpMethodName(HTTPMethod method)
+{
+  switch (method)
+  {
+  case HTTP_GET:
+    return "GET";
+  case HTTP_POST:
+    return "POST";
+  case HTTP_PUT:
+    return "PUT";
+  case HTTP_DELETE:
+    return "DELETE";
+  default:
+    return "ANY";
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+#define MAX_ROUTE_METRICS 24 // Routes that get their own request counter
+
+// Count, total and worst case of a duration. Every metric has a single
+// writer, so updates are plain stores without locking; a scrape may see a
+// sample counted but not yet summed, which the next scrape corrects.
+struct TimingMetric
+{
+  uint32_t count;
+  uint64_t sumUs;
+  uint32_t maxUs;
+};
+
+// Per-route request timing, filled by the handler wrapper in main.cpp
+struct RouteMetric
+{
+  const char *path;
+  HTTPMethod method;
+  TimingMetric timing;
+};
+
+// Counters for /metrics. The comment says which task writes each one.
+struct Metrics
+{
+  TimingMetric loop;          // loop()
+  TimingMetric frameCompute;  // Render task, effect render only
+  uint32_t probeSuccesses;    // loop(), per finished probe
+  uint32_t probeFailures;
+  uint64_t probeLatencySumMs; // Successful probes only, matches the probe histogram
+  uint32_t wifiDisconnects;   // WiFi event task
+  uint32_t wifiReconnects;    // IP acquired again after the first time
+  uint32_t bootFirstFrameUs;  // Render task. Boot phases in microseconds since reset, 0 until reached.
+  uint32_t bootIpUs;          // WiFi event task, first IP only
+  uint32_t bootFirstProbeUs;  // loop()
+  uint32_t eventClientsDropped; // loop(), live status subscribers too slow to keep up
+};
+
+extern Metrics metrics;
+
+inline void recordTiming(TimingMetric &metric, uint32_t us)
+{
+  metric.count++;
+  metric.sumUs += us;
+  if (us > metric.maxUs)
+    metric.maxUs = us;
+}
+
+// Reserves a slot for a route, returns NULL once all slots are taken
+RouteMetric *addRouteMetric(const char *path, HTTPMethod method);
+uint8_t routeMetricCount();
+const RouteMetric &routeMetricAt(uint8_t index);
+
+const char *httpMethodName(HTTPMethod method);
@@ -0,0 +1,385 @@
+#include "probe.h"
+#include <WiFi.h>
+
+const uint16_t probeHistogramBounds[PROBE_HISTOGRAM_BUCKETS] = {25, 50, 100, 250, 500, 1000, 2500, 0xFFFF};
+
+// Owned by the loop task, the probe task only sees targets passed by value
+static ProbeTarget targets[MAX_PROBE_TARGETS];
+static uint8_t targetCount = 0;
+static uint8_t nextTarget = 0;
+
+static ProbeResult history[PROBE_HISTORY];
+static uint8_t historyHead = 0; // Slot for the next result
+static uint8_t historyCount = 0;
+static uint32_t histogram[PROBE_HISTOGRAM_BUCKETS];
+static InternetState state = INTERNET_UNKNOWN;
+
+// What the well-known connectivity checks answer. A captive portal or
+// filtering proxy typically redirects them or serves its own page with 200,
+// so the status alone is not enough for the ones that return a body.
+struct KnownCheck
+{
+  const char *path;
+  int16_t status;
+  const char *body;
+};
+
+static const KnownCheck knownChecks[] = {
+    {"/generate_204", 204, NULL},
+    {"/gen_204", 204, NULL},
+    {"/connecttest.txt", 200, "Microsoft Connect Test"},
+    {"/ncsi.txt", 200, "Microsoft NCSI"},
+    {"/hotspot-detect.html", 200, "Success"},
+    {"/success.txt", 200, "success"},
+};
+
+#define PROBE_RESPONSE_SIZE 512 // Enough for the headers and body of every known check
+
+struct ProbeRequest
+{
+  ProbeTarget target;
+  uint8_t index;
+};
+
+static QueueHandle_t requestQueue = NULL;
+static QueueHandle_t resultQueue = NULL;
+static bool pending = false;
+
+static void probeTask(void *param);
+
+static void setExpectedResponse(ProbeTarget &target)
+{
+  target.expectStatus = 200;
+  target.expectBody = NULL;
+  for (const KnownCheck &check : knownChecks)
+  {
+    if (strcmp(target.path, check.path) == 0)
+    {
+      target.expectStatus = check.status;
+      target.expectBody = check.body;
+      return;
+    }
+  }
+}
+
+static bool parseTargets(const char *list, ProbeTarget *parsed, uint8_t &count)
+{
+  count = 0;
+  const char *entry = list;
+  while (*entry)
+  {
+    const char *end = strchr(entry, ',');
+    size_t length = end ? end - entry : strlen(entry);
+    if (length > 0)
+    {
+      if (count == MAX_PROBE_TARGETS)
+        return false;
+
+      char text[96];
+      if (length >= sizeof(text))
+        return false;
+      memcpy(text, entry, length);
+      text[length] = '\0';
+
+      // host[:port]/path, the path defaults to /
+      ProbeTarget &target = parsed[count];
+      char *path = strchr(text, '/');
+      strlcpy(target.path, path ? path : "/", sizeof(target.path));
+      if (path)
+        *path = '\0';
+      char *port = strchr(text, ':');
+      target.port = 80;
+      if (port)
+      {
+        *port++ = '\0';
+        long value = atol(port);
+        if (value < 1 || value > 65535)
+          return false;
+        target.port = value;
+      }
+      if (text[0] == '\0' || strlen(text) >= sizeof(target.host) || (path && strlen(path) >= sizeof(target.path)))
+        return false;
+      strlcpy(target.host, text, sizeof(target.host));
+      setExpectedResponse(target);
+      count++;
+    }
+    entry += length;
+    if (*entry == ',')
+      entry++;
+  }
+  return count > 0;
+}
+
+void beginProbe(Preferences &prefs)
+{
+  if (requestQueue != NULL)
+    return;
+
+  char list[MAX_PROBE_TARGETS * 104]; // "host:port/path," per target
+  if (!prefs.isKey("probe_targets") || prefs.getString("probe_targets", list, sizeof(list)) == 0 ||
+      !parseTargets(list, targets, targetCount))
+  {
+    parseTargets(DEFAULT_PROBE_TARGETS, targets, targetCount);
+  }
+
+  requestQueue = xQueueCreate(1, sizeof(ProbeRequest));
+  resultQueue = xQueueCreate(1, sizeof(ProbeResult));
+  xTaskCreate(probeTask, "internetProbe", 4096, NULL, 1, NULL);
+}
+
+bool requestProbe()
+{
+  if (requestQueue == NULL || pending)
+    return false;
+
+  ProbeRequest request;
+  request.index = nextTarget;
+  request.target = targets[nextTarget];
+  if (xQueueSend(requestQueue, &request, 0) != pdTRUE)
+    return false;
+
+  // Rotate so one unreachable target cannot decide the state on its own
+  nextTarget = (nextTarget + 1) % targetCount;
+  pending = true;
+  return true;
+}
+
+bool probePending()
+{
+  return pending;
+}
+
+static void updateState()
+{
+  uint8_t window = min<uint8_t>(historyCount, PROBE_WINDOW);
+  uint8_t failures = 0;
+  uint32_t latencySum = 0;
+  uint8_t successes = 0;
+  for (uint8_t i = 0; i < window; i++)
+  {
+    const ProbeResult &result = probeHistoryAt(i);
+    if (result.success)
+    {
+      successes++;
+      latencySum += result.totalMs;
+    }
+    else
+    {
+      failures++;
+    }
+  }
+
+  if (state == INTERNET_UNKNOWN)
+  {
+    // Nothing to be sticky about yet, the first result decides
+    state = probeHistoryAt(0).success ? INTERNET_ONLINE : INTERNET_OFFLINE;
+  }
+  else if (failures >= PROBE_FAILURES_OFFLINE)
+  {
+    state = INTERNET_OFFLINE;
+  }
+  else if (state == INTERNET_OFFLINE && !probeHistoryAt(0).success)
+  {
+    // Stay offline until a probe actually gets through
+  }
+  else
+  {
+    state = INTERNET_ONLINE;
+  }
+
+  if (state == INTERNET_ONLINE && successes > 0 && latencySum / successes > PROBE_DEGRADED_LATENCY)
+  {
+    state = INTERNET_DEGRADED;
+  }
+}
+
+bool pollProbeResult(ProbeResult &result)
+{
+  if (resultQueue == NULL || xQueueReceive(resultQueue, &result, 0) != pdTRUE)
+    return false;
+
+  pending = false;
+  history[historyHead] = result;
+  historyHead = (historyHead + 1) % PROBE_HISTORY;
+  if (historyCount < PROBE_HISTORY)
+    historyCount++;
+
+  if (result.success)
+  {
+    uint8_t bucket = 0;
+    while (result.totalMs > probeHistogramBounds[bucket] && bucket < PROBE_HISTOGRAM_BUCKETS - 1)
+      bucket++;
+    histogram[bucket]++;
+  }
+
+  updateState();
+  return true;
+}
+
+InternetState internetState()
+{
+  return state;
+}
+
+const char *internetStateName(InternetState value)
+{
+  switch (value)
+  {
+  case INTERNET_OFFLINE:
+    return "offline";
+  case INTERNET_DEGRADED:
+    return "degraded";
+  case INTERNET_ONLINE:
+    return "online";
+  default:
+    return "unknown";
+  }
+}
+
+uint8_t probeHistoryCount()
+{
+  return historyCount;
+}
+
+const ProbeResult &probeHistoryAt(uint8_t index)
+{
+  return history[(historyHead + PROBE_HISTORY - 1 - index) % PROBE_HISTORY];
+}
+
+const uint32_t *probeHistogram()
+{
+  return histogram;
+}
+
+uint8_t probeTargetCount()
+{
+  return targetCount;
+}
+
+const ProbeTarget &probeTargetAt(uint8_t index)
+{
+  return targets[index];
+}
+
+bool setProbeTargets(Preferences &prefs, const char *list)
+{
+  ProbeTarget parsed[MAX_PROBE_TARGETS];
+  uint8_t count;
+  if (!parseTargets(list, parsed, count))
+    return false;
+
+  memcpy(targets, parsed, sizeof(parsed));
+  targetCount = count;
+  nextTarget = 0;
+  prefs.putString("probe_targets", list);
+  return true;
+}
+
+static uint16_t elapsedSince(uint32_t start)
+{
+  return min<uint32_t>(millis() - start, 0xFFFF);
+}
+
+static void runProbe(const ProbeRequest &request, ProbeResult &result)
+{
+  const ProbeTarget &target = request.target;
+  result.target = request.index;
+  result.success = false;
+  result.dnsMs = result.connectMs = result.firstByteMs = 0;
+
+  // DNS
+  IPAddress address;
+  uint32_t stageStart = millis();
+  if (!WiFi.hostByName(target.host, address))
+  {
+    result.status = PROBE_ERROR_DNS;
+    return;
+  }
+  result.dnsMs = elapsedSince(stageStart);
+
+  // TCP connect
+  WiFiClient client;
+  stageStart = millis();
+  if (!client.connect(address, target.port, PROBE_TIMEOUT))
+  {
+    result.status = PROBE_ERROR_CONNECT;
+    return;
+  }
+  result.connectMs = elapsedSince(stageStart);
+
+  // Request to first response byte
+  char line[160];
+  snprintf(line, sizeof(line), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", target.path, target.host);
+  stageStart = millis();
+  client.print(line);
+  while (!client.available())
+  {
+    if (!client.connected() || millis() - stageStart >= PROBE_TIMEOUT)
+    {
+      result.status = PROBE_ERROR_TIMEOUT;
+      client.stop();
+      return;
+    }
+    vTaskDelay(1);
+  }
+  result.firstByteMs = elapsedSince(stageStart);
+
+  // The server closes after the response, the checks are small enough to
+  // keep whole. Anything past the buffer is not needed.
+  char response[PROBE_RESPONSE_SIZE];
+  size_t length = 0;
+  while (length < sizeof(response) - 1 && (client.connected() || client.available()))
+  {
+    int count = client.read((uint8_t *)response + length, sizeof(response) - 1 - length);
+    if (count > 0)
+      length += count;
+    else if (millis() - stageStart >= PROBE_TIMEOUT)
+      break;
+    else
+      vTaskDelay(1);
+  }
+  response[length] = '\0';
+  client.stop();
+
+  // Status line: "HTTP/1.x NNN ..."
+  const char *code = strchr(response, ' ');
+  if (strncmp(response, "HTTP/1.", 7) != 0 || code == NULL)
+  {
+    result.status = PROBE_ERROR_RESPONSE;
+    return;
+  }
+  result.status = atoi(code + 1);
+  if (result.status != target.expectStatus)
+    return;
+
+  if (target.expectBody != NULL)
+  {
+    const char *body = strstr(response, "\r\n\r\n");
+    if (body == NULL || strstr(body, target.expectBody) == NULL)
+    {
+      result.status = PROBE_ERROR_BODY;
+      return;
+    }
+  }
+  result.success = true;
+}
+
+static void probeTask(void *param)
+{
+  ProbeRequest request;
+
+  for (;;)
+  {
+    if (xQueueReceive(requestQueue, &request, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    // Blocking network calls run here so loop() keeps serving HTTP
+    ProbeResult result;
+    uint32_t start = millis();
+    runProbe(request, result);
+    result.totalMs = elapsedSince(start);
+    result.timestamp = millis();
+
+    xQueueOverwrite(resultQueue, &result);
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#define MAX_PROBE_TARGETS 4
+#define PROBE_HISTORY 32           // Results kept in the ring buffer
+#define PROBE_TIMEOUT 3000         // Per-stage timeout in milliseconds
+#define PROBE_WINDOW 5             // M: recent probes the state is decided on
+#define PROBE_FAILURES_OFFLINE 3   // N: failures within the window that mean offline
+#define PROBE_DEGRADED_LATENCY 800 // Average successful latency above this is degraded, in milliseconds
+#define PROBE_HISTOGRAM_BUCKETS 8
+#define DEFAULT_PROBE_TARGETS "clients3.google.com/generate_204,connectivitycheck.gstatic.com/generate_204,www.msftconnecttest.com/connecttest.txt"
+
+enum InternetState : uint8_t
+{
+  INTERNET_UNKNOWN,
+  INTERNET_OFFLINE,
+  INTERNET_DEGRADED,
+  INTERNET_ONLINE
+};
+
+// Failure stages, reported as negative status codes
+#define PROBE_ERROR_DNS -1
+#define PROBE_ERROR_CONNECT -2
+#define PROBE_ERROR_TIMEOUT -3
+#define PROBE_ERROR_RESPONSE -4
+#define PROBE_ERROR_BODY -5 // Expected status, but the body is not what the check serves, e.g. a portal page
+
+struct ProbeTarget
+{
+  char host[48];
+  uint16_t port;
+  char path[48];
+  int16_t expectStatus;   // Known check paths get their own, anything else must answer 200
+  const char *expectBody; // Text the body must contain, NULL to skip the check
+};
+
+struct ProbeResult
+{
+  uint32_t timestamp; // millis() when the probe finished
+  int16_t status;     // HTTP status code or PROBE_ERROR_*
+  uint8_t target;     // Index into the target list
+  bool success;       // Expected status and body
+  uint16_t dnsMs;
+  uint16_t connectMs;
+  uint16_t firstByteMs; // Request sent to first response byte
+  uint16_t totalMs;
+};
+
+// Upper bounds of the latency histogram buckets in milliseconds, the last one is open
+extern const uint16_t probeHistogramBounds[PROBE_HISTOGRAM_BUCKETS];
+
+// Loads the target list and starts the probe task
+void beginProbe(Preferences &prefs);
+
+// Starts a probe against the next target, false if one is still running
+bool requestProbe();
+bool probePending();
+
+// Collects a finished probe, records it and updates the internet state.
+// Returns false if no probe finished since the last call.
+bool pollProbeResult(ProbeResult &result);
+
+InternetState internetState();
+const char *internetStateName(InternetState state);
+
+// History, index 0 is the newest result
+uint8_t probeHistoryCount();
+const ProbeResult &probeHistoryAt(uint8_t index);
+const uint32_t *probeHistogram();
+
+uint8_t probeTargetCount();
+const ProbeTarget &probeTargetAt(uint8_t index);
+
+// Parses a comma separated "host[:port]/path" list, stores it and uses it from
+// the next probe on. Returns false and keeps the old list if it is malformed.
+bool setProbeTargets(Preferences &prefs, const char *list);
@@ -0,0 +1,107 @@
+#include "scheduler.h"
+
+static SchedulerTask tasks[MAX_SCHEDULER_TASKS];
+static uint8_t taskCount = 0;
+static SchedulerClock clockSource = 0;
+
+void setSchedulerClock(SchedulerClock clock)
+{
+  clockSource = clock;
+}
+
+int addSchedulerTask(const char *name, SchedulerFunction run, uint32_t periodUs, uint32_t budgetUs)
+{
+  if (taskCount == MAX_SCHEDULER_TASKS)
+    return -1;
+
+  SchedulerTask &task = tasks[taskCount];
+  task.name = name;
+  task.run = run;
+  task.periodUs = periodUs;
+  task.budgetUs = budgetUs;
+  task.dueUs = clockSource();
+  task.signalled = false;
+  task.runs = 0;
+  task.runTimeUs = 0;
+  task.maxRunUs = 0;
+  task.overruns = 0;
+  task.maxLateUs = 0;
+  return taskCount++;
+}
+
+void setSchedulerTaskPeriod(int id, uint32_t periodUs)
+{
+  if (id < 0 || id >= taskCount || tasks[id].periodUs == periodUs)
+    return;
+  tasks[id].periodUs = periodUs;
+  tasks[id].dueUs = clockSource() + periodUs;
+}
+
+void signalSchedulerTask(int id)
+{
+  if (id >= 0 && id < taskCount)
+    tasks[id].signalled = true;
+}
+
+static bool isDue(const SchedulerTask &task, uint32_t now)
+{
+  return task.signalled || (task.periodUs != 0 && (int32_t)(now - task.dueUs) >= 0);
+}
+
+uint32_t runScheduler()
+{
+  for (uint8_t i = 0; i < taskCount; i++)
+  {
+    SchedulerTask &task = tasks[i];
+    uint32_t start = clockSource();
+    if (!isDue(task, start))
+      continue;
+
+    // Signals arriving while the task runs make it due again
+    bool signalled = task.signalled;
+    task.signalled = false;
+    if (!signalled && start - task.dueUs > task.maxLateUs)
+      task.maxLateUs = start - task.dueUs;
+
+    task.run();
+
+    uint32_t end = clockSource();
+    uint32_t elapsed = end - start;
+    task.runs++;
+    task.runTimeUs += elapsed;
+    if (elapsed > task.maxRunUs)
+      task.maxRunUs = elapsed;
+    if (elapsed > task.budgetUs)
+      task.overruns++;
+
+    // Stay on the period grid unless a whole period was missed
+    if (task.periodUs != 0 && (int32_t)(start - task.dueUs) >= 0)
+    {
+      task.dueUs += task.periodUs;
+      if ((int32_t)(end - task.dueUs) >= 0)
+        task.dueUs = end + task.periodUs;
+    }
+  }
+
+  uint32_t now = clockSource();
+  uint32_t wait = SCHEDULER_MAX_WAIT;
+  for (uint8_t i = 0; i < taskCount; i++)
+  {
+    const SchedulerTask &task = tasks[i];
+    if (isDue(task, now))
+      return 0;
+    if (task.periodUs != 0 && task.dueUs - now < wait)
+      wait = task.dueUs - now;
+  }
+  return wait;
+}
+
+uint8_t schedulerTaskCount()
+{
+  return taskCount;
+}
+
+const SchedulerTask &schedulerTaskAt(uint8_t index)
+{
+  return tasks[index];
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#define MAX_SCHEDULER_TASKS 12     // Subsystems that can register with the scheduler
+#define SCHEDULER_MAX_WAIT 100000  // Longest sleep when nothing is due, in microseconds
+
+// Cooperative deadline scheduler for the Arduino loop. Each subsystem
+// registers a function with a period; loop() runs whatever is due and then
+// sleeps until the next deadline instead of polling everything on a fixed
+// delay. It has no Arduino dependencies, so it also builds on a host with
+// a fake clock.
+
+// Time source in microseconds, micros() on the device
+typedef uint32_t (*SchedulerClock)();
+typedef void (*SchedulerFunction)();
+
+struct SchedulerTask
+{
+  const char *name;
+  SchedulerFunction run;
+  uint32_t periodUs;  // 0 for tasks that only run when signalled
+  uint32_t budgetUs;  // Runs longer than this count as overruns
+  uint32_t dueUs;
+  volatile bool signalled;
+
+  // Accounting, written by the scheduler only
+  uint32_t runs;
+  uint64_t runTimeUs;
+  uint32_t maxRunUs;
+  uint32_t overruns;
+  uint32_t maxLateUs; // Worst start delay past the deadline
+};
+
+void setSchedulerClock(SchedulerClock clock);
+
+// Returns the task id, or -1 once all slots are taken. The first run is due right away.
+int addSchedulerTask(const char *name, SchedulerFunction run, uint32_t periodUs, uint32_t budgetUs);
+
+// Changes a task's period, 0 leaves it to signals. The new period counts
+// from now. A task may change its own period while it runs.
+void setSchedulerTaskPeriod(int id, uint32_t periodUs);
+
+// Makes a task due now. Safe to call from other tasks; whoever sleeps on
+// runScheduler()'s result still has to be woken.
+void signalSchedulerTask(int id);
+
+// Runs every due task once, in registration order. Returns the time until
+// the next deadline in microseconds, 0 if a task is already due again.
+uint32_t runScheduler();
+
+uint8_t schedulerTaskCount();
+const SchedulerTask &schedulerTaskAt(uint8_t index);
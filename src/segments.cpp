@@ -0,0 +1,53 @@
+#include "segments.h"
+
+int findInvalidSegment(const Segment *segments, int ledCount)
+{
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+  {
+    const Segment &segment = segments[i];
+    if (segment.length == 0)
+    {
+      if (i == 0)
+        return 0; // The main segment cannot be removed
+      continue;
+    }
+    if (segment.effect >= EFFECT_COUNT || segment.start + segment.length > ledCount)
+      return i;
+
+    for (uint8_t j = 0; j < i; j++)
+    {
+      const Segment &other = segments[j];
+      if (other.length != 0 && segment.start < other.start + other.length && other.start < segment.start + segment.length)
+        return i;
+    }
+  }
+  return -1;
+}
+
+bool segmentsStill(const Segment *segments)
+{
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+  {
+    if (segments[i].length != 0 && !(effectRegistry[segments[i].effect].flags & EFFECT_STILL))
+      return false;
+  }
+  return true;
+}
+
+void renderSegments(CRGB *leds, int ledCount, const Segment *segments, EffectState *states, uint8_t dirty,
+                    uint32_t now, uint32_t elapsed, const EffectSettings &settings)
+{
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+  {
+    const Segment &segment = segments[i];
+    if (segment.length == 0 || segment.start >= ledCount)
+      continue;
+    if ((effectRegistry[segment.effect].flags & EFFECT_STILL) && !(dirty & (1 << i)))
+      continue; // Unchanged, its pixels are still in place
+
+    // The strip can be shorter than when the segment was set up
+    int count = min<int>(segment.length, ledCount - segment.start);
+    EffectFrame frame = {leds + segment.start, count, now, elapsed, &states[i]};
+    renderEffect(segment.effect, frame, settings);
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "effects.h"
+
+#define MAX_SEGMENTS 4
+
+// A range of the strip running its own effect. Segment 0 always exists and
+// shows the main effect; the others are unused while their length is 0.
+// Pixels outside every segment stay black. The timeline effect compiles for
+// one length at a time, so it is best used by a single segment.
+struct Segment
+{
+  uint16_t start;
+  uint16_t length;
+  EffectId effect;
+};
+
+// Checks that every used segment lies on the strip and none overlap.
+// Returns the index of the first bad segment, or -1 if the table is valid.
+int findInvalidSegment(const Segment *segments, int ledCount);
+
+// True if no used segment animates, so frames only change with settings
+bool segmentsStill(const Segment *segments);
+
+// Draws every used segment into its range of leds. Still segments are only
+// drawn when their bit in dirty is set, otherwise they keep their pixels.
+// states holds one EffectState per segment.
+void renderSegments(CRGB *leds, int ledCount, const Segment *segments, EffectState *states, uint8_t dirty,
+                    uint32_t now, uint32_t elapsed, const EffectSettings &settings);
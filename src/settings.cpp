@@ -0,0 +1,112 @@
+#include "settings.h"
+
+static DeviceSettings pending;
+static bool dirty = false;
+static uint32_t lastChange = 0;
+static uint32_t flashWrites = 0;
+
+// CRC-16/CCITT-FALSE
+static uint16_t crc16(const uint8_t *data, size_t length)
+{
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++)
+  {
+    crc ^= data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static void encode(const DeviceSettings &settings, uint8_t *blob)
+{
+  blob[0] = SETTINGS_VERSION;
+  blob[1] = settings.effect;
+  blob[2] = settings.fps;
+  blob[3] = settings.brightness;
+  blob[4] = settings.speed & 0xFF;
+  blob[5] = settings.speed >> 8;
+  blob[6] = settings.staticColor.r;
+  blob[7] = settings.staticColor.g;
+  blob[8] = settings.staticColor.b;
+  blob[9] = settings.snakeColor.r;
+  blob[10] = settings.snakeColor.g;
+  blob[11] = settings.snakeColor.b;
+
+  uint8_t *segment = blob + 12;
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++, segment += 5)
+  {
+    segment[0] = settings.segments[i].start & 0xFF;
+    segment[1] = settings.segments[i].start >> 8;
+    segment[2] = settings.segments[i].length & 0xFF;
+    segment[3] = settings.segments[i].length >> 8;
+    segment[4] = settings.segments[i].effect;
+  }
+
+  uint16_t crc = crc16(blob, SETTINGS_BLOB_SIZE - 2);
+  blob[SETTINGS_BLOB_SIZE - 2] = crc & 0xFF;
+  blob[SETTINGS_BLOB_SIZE - 1] = crc >> 8;
+}
+
+bool loadSettings(Preferences &prefs, DeviceSettings &settings)
+{
+  uint8_t blob[SETTINGS_BLOB_SIZE];
+  size_t length = prefs.getBytes("settings", blob, sizeof(blob));
+  bool current = length == SETTINGS_BLOB_SIZE && blob[0] == SETTINGS_VERSION;
+  if (!current && !(length == SETTINGS_V1_SIZE && blob[0] == 1))
+    return false;
+  if (crc16(blob, length - 2) != (blob[length - 2] | (blob[length - 1] << 8)))
+    return false;
+
+  settings.effect = blob[1];
+  settings.fps = blob[2];
+  settings.brightness = blob[3];
+  settings.speed = blob[4] | (blob[5] << 8);
+  settings.staticColor = CRGB(blob[6], blob[7], blob[8]);
+  settings.snakeColor = CRGB(blob[9], blob[10], blob[11]);
+
+  const uint8_t *segment = blob + 12;
+  for (uint8_t i = 0; current && i < MAX_SEGMENTS; i++, segment += 5)
+  {
+    settings.segments[i].start = segment[0] | (segment[1] << 8);
+    settings.segments[i].length = segment[2] | (segment[3] << 8);
+    settings.segments[i].effect = (EffectId)segment[4];
+  }
+  return true;
+}
+
+void updateSettings(const DeviceSettings &settings)
+{
+  pending = settings;
+  dirty = true;
+  lastChange = millis(); // Every change restarts the quiet period
+}
+
+void flushSettings(Preferences &prefs, bool force)
+{
+  if (!dirty || (!force && millis() - lastChange < SETTINGS_QUIET_PERIOD))
+    return;
+
+  uint8_t blob[SETTINGS_BLOB_SIZE];
+  encode(pending, blob);
+
+  // NVS writes are skipped when the stored blob is identical, e.g. after a
+  // color was dragged away and back
+  uint8_t stored[SETTINGS_BLOB_SIZE];
+  if (prefs.getBytes("settings", stored, sizeof(stored)) != sizeof(stored) || memcmp(stored, blob, sizeof(blob)) != 0)
+  {
+    prefs.putBytes("settings", blob, sizeof(blob));
+    flashWrites++;
+  }
+  dirty = false;
+}
+
+void discardSettings()
+{
+  dirty = false;
+}
+
+uint32_t settingsFlashWrites()
+{
+  return flashWrites;
+}
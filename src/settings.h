@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <Preferences.h>
+#include "segments.h"
+
+#define SETTINGS_VERSION 2
+#define SETTINGS_QUIET_PERIOD 5000 // Write once nothing changed for this long, in milliseconds
+#define SETTINGS_BLOB_SIZE (14 + MAX_SEGMENTS * 5)
+#define SETTINGS_V1_SIZE 14        // Before segments, still accepted at boot
+
+// User choices that survive a reboot. Kept in RAM and written to NVS as one
+// blob, so a burst of changes costs a single flash write:
+//   version, effect, fps, brightness, speed (u16), static color (r, g, b),
+//   snake color (r, g, b), then start (u16), length (u16) and effect of each
+//   segment, CRC-16 over the preceding bytes (u16), little endian
+struct DeviceSettings
+{
+  uint8_t effect; // EffectId
+  uint8_t fps;
+  uint8_t brightness;
+  uint16_t speed;
+  CRGB staticColor;
+  CRGB snakeColor;
+  Segment segments[MAX_SEGMENTS];
+};
+
+// One read at boot. Returns false and leaves settings untouched if nothing
+// is stored or the blob has the wrong version or checksum. Version 1 blobs
+// leave the segments untouched.
+bool loadSettings(Preferences &prefs, DeviceSettings &settings);
+
+// Records new values, they are written by flushSettings() after the quiet period
+void updateSettings(const DeviceSettings &settings);
+
+// Call from loop(). force writes pending changes right away, e.g. before a restart.
+void flushSettings(Preferences &prefs, bool force = false);
+
+// Drops pending changes, used before a factory reset clears the store
+void discardSettings();
+
+uint32_t settingsFlashWrites();
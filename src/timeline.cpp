@@ -0,0 +1,323 @@
+#include "timeline.h"
+#include <LittleFS.h>
+
+// Built-in timeline used until one is uploaded: a blue to purple gradient
+// with a white block sweeping back and forth while the strip breathes
+static const uint8_t defaultTimeline[] PROGMEM = {
+    'W', 'M', 'T', 'L', TIMELINE_VERSION, 5, 0xA0, 0x0F, // 5 steps, 4000 ms
+    TIMELINE_GRADIENT, EASE_LINEAR, 0x00, 0x00, 0xA0, 0x0F, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x20, 0xFF, 0x80, 0x00, 0xFF,
+    TIMELINE_SEGMENT, EASE_IN_OUT, 0x00, 0x00, 0xD0, 0x07, 0x00, 0x00, 0x66, 0xE6, 0x99, 0x19, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00,
+    TIMELINE_SEGMENT, EASE_IN_OUT, 0xD0, 0x07, 0xA0, 0x0F, 0x66, 0xE6, 0x00, 0x00, 0x99, 0x19, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00,
+    TIMELINE_FADE, EASE_IN_OUT, 0x00, 0x00, 0xD0, 0x07, 0x00, 0x00, 0xFF, 0xFF, 0x78, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    TIMELINE_FADE, EASE_IN_OUT, 0xD0, 0x07, 0xA0, 0x0F, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+// A step laid out for one strip length
+struct TimelineInstruction
+{
+  uint8_t op;
+  uint8_t easing;
+  uint16_t startMs;
+  uint16_t spanMs;
+  uint16_t first;        // First pixel of the range, or of the segment at its start
+  uint16_t count;        // Pixels in the range, or segment width
+  int16_t travel;        // Segment: pixels moved over the step
+  uint32_t gradientStep; // Gradient: blend amount per pixel, 16.16 fixed point
+  CRGB colorA;
+  CRGB colorB;
+  uint8_t levelA;
+  uint8_t levelB;
+};
+
+// Handoff from the loop task: it fills staged and sets stagedReady, the
+// render task copies it out in acceptTimeline() and clears the flag
+static Timeline staged;
+static volatile bool stagedReady = false;
+
+// Render task side
+static Timeline source;
+static TimelineInstruction program[MAX_TIMELINE_STEPS];
+static uint8_t programCount = 0;
+static int compiledFor = -1; // Strip length the program was laid out for
+
+// Loop task side
+static uint8_t upload[TIMELINE_MAX_SIZE];
+static size_t uploadLength = 0;
+static bool uploadTooLarge = false;
+static uint8_t loadedCount = 0;
+static uint16_t loadedDuration = 0;
+static bool loadedFromFlash = false;
+
+static uint16_t readU16(const uint8_t *data)
+{
+  return data[0] | (data[1] << 8);
+}
+
+bool parseTimeline(const uint8_t *data, size_t length, Timeline &timeline)
+{
+  if (length < TIMELINE_HEADER_SIZE || memcmp(data, "WMTL", 4) != 0 || data[4] != TIMELINE_VERSION)
+    return false;
+
+  uint8_t count = data[5];
+  uint16_t duration = readU16(data + 6);
+  if (count == 0 || count > MAX_TIMELINE_STEPS || duration == 0 ||
+      length != TIMELINE_HEADER_SIZE + (size_t)count * TIMELINE_STEP_SIZE)
+    return false;
+
+  const uint8_t *record = data + TIMELINE_HEADER_SIZE;
+  for (uint8_t i = 0; i < count; i++, record += TIMELINE_STEP_SIZE)
+  {
+    TimelineStep &step = timeline.steps[i];
+    step.op = record[0];
+    step.easing = record[1];
+    step.startMs = readU16(record + 2);
+    step.endMs = readU16(record + 4);
+    step.from = readU16(record + 6);
+    step.to = readU16(record + 8);
+    step.param = readU16(record + 10);
+    step.colorA = CRGB(record[12], record[13], record[14]);
+    step.colorB = CRGB(record[15], record[16], record[17]);
+
+    if (step.op >= TIMELINE_OP_COUNT || step.easing >= EASE_COUNT ||
+        step.startMs >= step.endMs || step.endMs > duration)
+      return false;
+  }
+
+  timeline.count = count;
+  timeline.durationMs = duration;
+  return true;
+}
+
+static bool handOver(const Timeline &timeline, bool fromFlash)
+{
+  if (stagedReady)
+    return false;
+
+  staged = timeline;
+  stagedReady = true;
+  loadedCount = timeline.count;
+  loadedDuration = timeline.durationMs;
+  loadedFromFlash = fromFlash;
+  return true;
+}
+
+void beginTimeline()
+{
+  if (!LittleFS.begin(true))
+    Serial.println("LittleFS mount failed, timelines are not persisted");
+
+  File file = LittleFS.exists(TIMELINE_FILE) ? LittleFS.open(TIMELINE_FILE, "r") : File();
+  if (file)
+  {
+    uploadLength = file.read(upload, sizeof(upload));
+    file.close();
+    if (parseTimeline(upload, uploadLength, staged) && handOver(staged, true))
+      return;
+    Serial.println("Stored timeline is invalid, using the built-in one");
+  }
+
+  memcpy_P(upload, defaultTimeline, sizeof(defaultTimeline));
+  parseTimeline(upload, sizeof(defaultTimeline), staged);
+  handOver(staged, false);
+}
+
+void beginTimelineUpload()
+{
+  uploadLength = 0;
+  uploadTooLarge = false;
+}
+
+void writeTimelineUpload(const uint8_t *data, size_t length)
+{
+  if (uploadTooLarge || uploadLength + length > sizeof(upload))
+  {
+    uploadTooLarge = true;
+    return;
+  }
+  memcpy(upload + uploadLength, data, length);
+  uploadLength += length;
+}
+
+TimelineStatus commitTimelineUpload()
+{
+  if (uploadTooLarge)
+    return TIMELINE_TOO_LARGE;
+  if (stagedReady)
+    return TIMELINE_BUSY;
+
+  // staged is free until stagedReady is set again
+  if (!parseTimeline(upload, uploadLength, staged))
+    return TIMELINE_INVALID;
+
+  File file = LittleFS.open(TIMELINE_FILE, "w");
+  bool stored = file && file.write(upload, uploadLength) == uploadLength;
+  if (file)
+    file.close();
+  if (!stored)
+    return TIMELINE_STORAGE_FAILED;
+
+  handOver(staged, true);
+  return TIMELINE_OK;
+}
+
+const char *timelineStatusMessage(TimelineStatus status)
+{
+  switch (status)
+  {
+  case TIMELINE_OK:
+    return "Timeline stored";
+  case TIMELINE_TOO_LARGE:
+    return "Timeline too large";
+  case TIMELINE_INVALID:
+    return "Invalid timeline";
+  case TIMELINE_BUSY:
+    return "Previous timeline not applied yet, retry";
+  default:
+    return "Could not store timeline";
+  }
+}
+
+uint8_t timelineStepCount()
+{
+  return loadedCount;
+}
+
+uint16_t timelineDuration()
+{
+  return loadedDuration;
+}
+
+bool timelineFromFlash()
+{
+  return loadedFromFlash;
+}
+
+// Strip position for a 1/65535th fraction
+static uint16_t pixelAt(uint16_t position, int count)
+{
+  return (uint32_t)position * count / 65535;
+}
+
+static void compileTimeline(int count)
+{
+  for (uint8_t i = 0; i < source.count; i++)
+  {
+    const TimelineStep &step = source.steps[i];
+    TimelineInstruction &in = program[i];
+    in.op = step.op;
+    in.easing = step.easing;
+    in.startMs = step.startMs;
+    in.spanMs = step.endMs - step.startMs;
+    in.colorA = step.colorA;
+    in.colorB = step.colorB;
+    in.levelA = step.param >> 8;
+    in.levelB = step.param & 0xFF;
+    in.travel = 0;
+    in.gradientStep = 0;
+
+    uint16_t from = pixelAt(step.from, count);
+    uint16_t to = pixelAt(step.to, count);
+    if (step.op == TIMELINE_SEGMENT)
+    {
+      // Keep the whole block on the strip at both ends of its path
+      in.count = min<int>(max<int>(pixelAt(step.param, count), 1), count);
+      from = min<uint16_t>(from, count - in.count);
+      to = min<uint16_t>(to, count - in.count);
+      in.first = from;
+      in.travel = (int16_t)to - (int16_t)from;
+    }
+    else
+    {
+      in.first = min(from, to);
+      in.count = max(from, to) - in.first;
+      if (step.op == TIMELINE_GRADIENT && in.count > 0)
+        in.gradientStep = (255UL << 16) / in.count;
+    }
+  }
+
+  programCount = source.count;
+  compiledFor = count;
+}
+
+// Maps linear progress to eased progress, both 0..65535
+static uint16_t ease(uint8_t easing, uint16_t p)
+{
+  switch (easing)
+  {
+  case EASE_IN:
+    return (uint32_t)p * p >> 16;
+  case EASE_OUT:
+  {
+    uint16_t q = 65535 - p;
+    return 65535 - ((uint32_t)q * q >> 16);
+  }
+  case EASE_IN_OUT:
+  {
+    if (p < 32768)
+      return (uint32_t)p * p >> 15;
+    uint16_t q = 65535 - p;
+    return 65535 - ((uint32_t)q * q >> 15);
+  }
+  default:
+    return p;
+  }
+}
+
+static void runInstruction(const TimelineInstruction &in, CRGB *leds, uint32_t t)
+{
+  uint16_t progress = ease(in.easing, (t - in.startMs) * 65535 / in.spanMs);
+
+  switch (in.op)
+  {
+  case TIMELINE_FILL:
+    fill_solid(leds + in.first, in.count, blend(in.colorA, in.colorB, progress >> 8));
+    break;
+  case TIMELINE_GRADIENT:
+  {
+    uint32_t amount = 0;
+    for (uint16_t i = 0; i < in.count; i++)
+    {
+      leds[in.first + i] = blend(in.colorA, in.colorB, amount >> 16);
+      amount += in.gradientStep;
+    }
+    break;
+  }
+  case TIMELINE_SEGMENT:
+  {
+    int32_t position = in.first + ((int32_t)in.travel * progress / 65535);
+    fill_solid(leds + position, in.count, in.colorA);
+    break;
+  }
+  case TIMELINE_FADE:
+    nscale8(leds + in.first, in.count, lerp8by8(in.levelA, in.levelB, progress >> 8));
+    break;
+  }
+}
+
+void acceptTimeline()
+{
+  if (stagedReady)
+  {
+    source = staged;
+    stagedReady = false;
+    compiledFor = -1;
+  }
+}
+
+void renderTimeline(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings)
+{
+  if (compiledFor != frame.count)
+    compileTimeline(frame.count);
+
+  fill_solid(frame.leds, frame.count, CRGB::Black);
+  if (source.durationMs == 0)
+    return; // Nothing loaded yet
+
+  uint32_t t = frame.now % source.durationMs;
+  for (uint8_t i = 0; i < programCount; i++)
+  {
+    const TimelineInstruction &in = program[i];
+    if (t >= in.startMs && t - in.startMs < in.spanMs)
+      runInstruction(in, frame.leds, t);
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+#include "effects.h"
+
+#define MAX_TIMELINE_STEPS 32 // Primitives in one timeline
+#define TIMELINE_FILE "/timeline.bin"
+#define TIMELINE_VERSION 1
+#define TIMELINE_HEADER_SIZE 8
+#define TIMELINE_STEP_SIZE 18
+#define TIMELINE_MAX_SIZE (TIMELINE_HEADER_SIZE + MAX_TIMELINE_STEPS * TIMELINE_STEP_SIZE)
+
+// Binary format, little endian:
+//   header  "WMTL", version, step count, loop length in ms (u16)
+//   steps   op, easing, start ms (u16), end ms (u16), from (u16), to (u16),
+//           param (u16), color A (r, g, b), color B (r, g, b)
+// Steps are drawn in order, later ones on top. Positions are fractions of the
+// whole strip in 1/65535ths, so a timeline fits any strip length.
+enum TimelineOp : uint8_t
+{
+  TIMELINE_FILL,     // Range in a color blending from A to B over the step
+  TIMELINE_GRADIENT, // Range shaded from A at `from` to B at `to`
+  TIMELINE_SEGMENT,  // Block of color A, param wide, moving from `from` to `to`
+  TIMELINE_FADE,     // Scales the range, level from param's high byte to its low byte
+  TIMELINE_OP_COUNT
+};
+
+enum TimelineEasing : uint8_t
+{
+  EASE_LINEAR,
+  EASE_IN,
+  EASE_OUT,
+  EASE_IN_OUT,
+  EASE_COUNT
+};
+
+// One decoded step, laid out for a strip length only when compiled
+struct TimelineStep
+{
+  uint8_t op;
+  uint8_t easing;
+  uint16_t startMs;
+  uint16_t endMs;
+  uint16_t from;
+  uint16_t to;
+  uint16_t param;
+  CRGB colorA;
+  CRGB colorB;
+};
+
+struct Timeline
+{
+  uint16_t durationMs;
+  uint8_t count;
+  TimelineStep steps[MAX_TIMELINE_STEPS];
+};
+
+enum TimelineStatus : uint8_t
+{
+  TIMELINE_OK,
+  TIMELINE_TOO_LARGE,
+  TIMELINE_INVALID,
+  TIMELINE_BUSY,   // The render task has not picked up the previous timeline yet, only for back to back uploads
+  TIMELINE_STORAGE_FAILED
+};
+
+// Decodes and validates the binary format
+bool parseTimeline(const uint8_t *data, size_t length, Timeline &timeline);
+
+// Loads the stored timeline, or the built-in one if flash holds none
+void beginTimeline();
+
+// Uploads are collected in RAM, then validated, stored and handed to the render task
+void beginTimelineUpload();
+void writeTimelineUpload(const uint8_t *data, size_t length);
+TimelineStatus commitTimelineUpload();
+const char *timelineStatusMessage(TimelineStatus status);
+
+// Loaded timeline, as last handed to the render task
+uint8_t timelineStepCount();
+uint16_t timelineDuration();
+bool timelineFromFlash();
+
+// Render task only. Takes over a timeline handed over by the loop task. Runs
+// on every pass of the render task, whatever effect is shown, so the next
+// upload is not refused until the timeline effect is selected.
+void acceptTimeline();
+
+// Effect entry point. Recompiles the steps into pixel instructions when a new
+// timeline arrives or the strip length changes, then runs them without allocating.
+void renderTimeline(const EffectFrame &frame, const EffectParams &params, const EffectSettings &settings);
@@ -0,0 +1,109 @@
+#include "Arduino.h"
+#include <time.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static bool frozen = false;
+static uint64_t frozenUs = 0;
+
+static uint64_t monotonicNs()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+uint32_t micros()
+{
+  return frozen ? frozenUs : monotonicNs() / 1000;
+}
+
+uint32_t millis()
+{
+  return (frozen ? frozenUs : monotonicNs() / 1000) / 1000;
+}
+
+void delay(uint32_t ms)
+{
+  if (frozen)
+  {
+    advanceClock(ms);
+    return;
+  }
+  timespec wait = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000L};
+  nanosleep(&wait, NULL);
+}
+
+void freezeClock(uint32_t ms)
+{
+  frozen = true;
+  frozenUs = (uint64_t)ms * 1000;
+}
+
+void advanceClock(uint32_t ms)
+{
+  frozenUs += (uint64_t)ms * 1000;
+}
+
+uint32_t EspClass::getCycleCount()
+{
+  return (uint32_t)monotonicNs();
+}
+
+// The process ends, a test that gets here has failed anyway
+void EspClass::restart()
+{
+  printf("ESP.restart()\n");
+  exit(1);
+}
+
+size_t Print::print(const char *text)
+{
+  return write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::println(const char *text)
+{
+  return print(text) + print("\n");
+}
+
+// Like the ESP32 core: short output is formatted on the stack, longer
+// output into one block of the exact size
+size_t Print::printf(const char *format, ...)
+{
+  char local[64];
+  va_list args;
+  va_list copy;
+  va_start(args, format);
+  va_copy(copy, args);
+  int length = vsnprintf(local, sizeof(local), format, copy);
+  va_end(copy);
+  if (length < 0)
+  {
+    va_end(args);
+    return 0;
+  }
+
+  char *text = local;
+  if ((size_t)length >= sizeof(local))
+  {
+    text = (char *)malloc(length + 1);
+    if (text == NULL)
+    {
+      va_end(args);
+      return 0;
+    }
+    vsnprintf(text, length + 1, format, args);
+  }
+  va_end(args);
+  size_t written = write((const uint8_t *)text, length);
+  if (text != local)
+    free(text);
+  return written;
+}
+
+size_t HardwareSerial::write(const uint8_t *data, size_t length)
+{
+  return muted ? length : fwrite(data, 1, length, stdout);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+// The part of the Arduino core the firmware uses, on top of the C library
+// and std::thread. Not a general replacement.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "WString.h"
+
+using std::max;
+using std::min;
+
+#define PROGMEM
+#define PGM_P const char *
+#define memcpy_P memcpy
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+  size_t length = strlen(src);
+  if (size > 0)
+  {
+    size_t copied = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, copied);
+    dst[copied] = '\0';
+  }
+  return length;
+}
+#endif
+
+// Defined by the sketch, src/main.cpp
+void setup();
+void loop();
+
+// 32 bits like on the ESP32, so wraparound behaves the same. Runs on the
+// monotonic clock unless a test freezes it.
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+// Stops the clock at ms. From then on it only moves with advanceClock(),
+// for tests of time-based logic.
+void freezeClock(uint32_t ms);
+void advanceClock(uint32_t ms);
+
+// No pins on the host: every input reads HIGH, i.e. no button is pressed
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline int digitalRead(uint8_t pin) { return HIGH; }
+
+class Print;
+
+class Printable
+{
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &out) const = 0;
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t *data, size_t length) = 0;
+  size_t print(const char *text);
+  size_t print(const Printable &value) { return value.printTo(*this); }
+  size_t println(const char *text = "");
+  size_t println(const Printable &value) { return print(value) + print("\n"); }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// Writes to stdout, nothing is ever typed in. mute() is not in the real
+// API: it drops the output of tests that would flood the log.
+class HardwareSerial : public Print
+{
+public:
+  void begin(unsigned long baud) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  size_t write(const uint8_t *data, size_t length) override;
+  void mute(bool on) { muted = on; }
+
+private:
+  bool muted = false;
+};
+
+extern HardwareSerial Serial;
+
+#define NATIVE_HEAP_SIZE (64UL << 20) // Nominal, far above what the tests use
+
+// Cycle counter at a nominal 1000 MHz, i.e. one cycle per nanosecond, so
+// code converting cycles to time reports host nanoseconds. The heap calls
+// report the counting allocator in heap.cpp against a heap of
+// NATIVE_HEAP_SIZE bytes.
+class EspClass
+{
+public:
+  uint32_t getCpuFreqMHz() { return 1000; }
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  void restart();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,177 @@
+#include "FastLED.h"
+
+CFastLED FastLED;
+
+uint8_t scale8(uint8_t value, fract8 scale)
+{
+  return ((uint16_t)value * (1 + (uint16_t)scale)) >> 8;
+}
+
+uint8_t scale8_video(uint8_t value, fract8 scale)
+{
+  return (((uint16_t)value * scale) >> 8) + (value && scale ? 1 : 0);
+}
+
+uint8_t qadd8(uint8_t a, uint8_t b)
+{
+  unsigned sum = a + b;
+  return sum > 255 ? 255 : sum;
+}
+
+uint8_t qsub8(uint8_t a, uint8_t b)
+{
+  return a > b ? a - b : 0;
+}
+
+uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 amount)
+{
+  if (b > a)
+    return a + scale8(b - a, amount);
+  return a - scale8(a - b, amount);
+}
+
+uint8_t sin8(uint8_t theta)
+{
+  static const uint8_t b_m16_interleave[] = {0, 49, 49, 41, 90, 27, 117, 10};
+
+  uint8_t offset = theta;
+  if (theta & 0x40)
+    offset = 255 - offset;
+  offset &= 0x3F; // 0..63
+
+  uint8_t secoffset = offset & 0x0F; // 0..15
+  if (theta & 0x40)
+    secoffset++;
+
+  uint8_t section = offset >> 4; // 0..3
+  uint8_t s2 = section * 2;
+  uint8_t b = b_m16_interleave[s2];
+  uint8_t m16 = b_m16_interleave[s2 + 1];
+  uint8_t mx = (m16 * secoffset) >> 4;
+
+  int8_t y = mx + b;
+  if (theta & 0x80)
+    y = -y;
+  return y + 128;
+}
+
+uint8_t triwave8(uint8_t in)
+{
+  if (in & 0x80)
+    in = 255 - in;
+  return in << 1;
+}
+
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb)
+{
+  uint8_t hue = hsv.h;
+  uint8_t sat = hsv.s;
+  uint8_t val = hsv.v;
+
+  uint8_t offset8 = (hue & 0x1F) << 3;
+  uint8_t third = scale8(offset8, 256 / 3);     // Up to 85
+  uint8_t twoThirds = scale8(offset8, 512 / 3); // Up to 170
+
+  uint8_t r, g, b;
+  switch (hue >> 5)
+  {
+  case 0: // Red to orange
+    r = 255 - third, g = third, b = 0;
+    break;
+  case 1: // Orange to yellow
+    r = 171, g = 85 + third, b = 0;
+    break;
+  case 2: // Yellow to green
+    r = 171 - twoThirds, g = 170 + third, b = 0;
+    break;
+  case 3: // Green to aqua
+    r = 0, g = 255 - third, b = third;
+    break;
+  case 4: // Aqua to blue
+    r = 0, g = 171 - twoThirds, b = 85 + twoThirds;
+    break;
+  case 5: // Blue to purple
+    r = third, g = 0, b = 255 - third;
+    break;
+  case 6: // Purple to pink
+    r = 85 + third, g = 0, b = 171 - third;
+    break;
+  default: // Pink to red
+    r = 170 + third, g = 0, b = 85 - third;
+    break;
+  }
+
+  if (sat != 255)
+  {
+    if (sat == 0)
+    {
+      r = g = b = 255;
+    }
+    else
+    {
+      uint8_t desat = scale8_video(255 - sat, 255 - sat);
+      uint8_t satScale = 255 - desat;
+      r = scale8(r, satScale) + desat;
+      g = scale8(g, satScale) + desat;
+      b = scale8(b, satScale) + desat;
+    }
+  }
+
+  if (val != 255)
+  {
+    val = scale8_video(val, val);
+    r = scale8(r, val);
+    g = scale8(g, val);
+    b = scale8(b, val);
+  }
+  rgb = CRGB(r, g, b);
+}
+
+CRGB::CRGB(const CHSV &hsv)
+{
+  hsv2rgb_rainbow(hsv, *this);
+}
+
+CRGB &CRGB::nscale8(uint8_t scale)
+{
+  r = scale8(r, scale);
+  g = scale8(g, scale);
+  b = scale8(b, scale);
+  return *this;
+}
+
+CRGB &CRGB::nscale8_video(uint8_t scale)
+{
+  r = scale8_video(r, scale);
+  g = scale8_video(g, scale);
+  b = scale8_video(b, scale);
+  return *this;
+}
+
+CRGB blend(const CRGB &a, const CRGB &b, fract8 amount)
+{
+  return CRGB(lerp8by8(a.r, b.r, amount), lerp8by8(a.g, b.g, amount), lerp8by8(a.b, b.b, amount));
+}
+
+void fill_solid(CRGB *leds, int count, const CRGB &color)
+{
+  for (int i = 0; i < count; i++)
+    leds[i] = color;
+}
+
+void fill_rainbow(CRGB *leds, int count, uint8_t hue, uint8_t delta)
+{
+  for (int i = 0; i < count; i++, hue += delta)
+    hsv2rgb_rainbow(CHSV(hue, 240, 255), leds[i]);
+}
+
+void nscale8(CRGB *leds, uint16_t count, uint8_t scale)
+{
+  for (uint16_t i = 0; i < count; i++)
+    leds[i].nscale8(scale);
+}
+
+void fadeToBlackBy(CRGB *leds, uint16_t count, uint8_t amount)
+{
+  nscale8(leds, count, 255 - amount);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// FastLED's pixel types and the math helpers the effects use, in plain C++.
+// The 8-bit helpers follow FastLED's C fallbacks, so frames match the
+// device; hsv2rgb_rainbow() is FastLED's algorithm without the yellow and
+// green tweaks, close but not bit-exact. Controllers keep their pixels,
+// show() sends them nowhere.
+
+#include <Arduino.h>
+
+typedef uint8_t fract8;
+
+struct CHSV
+{
+  uint8_t h, s, v;
+  CHSV() {}
+  CHSV(uint8_t hue, uint8_t sat, uint8_t val) : h(hue), s(sat), v(val) {}
+};
+
+struct CRGB
+{
+  union
+  {
+    struct
+    {
+      uint8_t r, g, b;
+    };
+    uint8_t raw[3];
+  };
+
+  enum HTMLColorCode : uint32_t
+  {
+    Black = 0x000000,
+    Blue = 0x0000FF,
+    Green = 0x008000,
+    Red = 0xFF0000,
+    White = 0xFFFFFF,
+  };
+
+  CRGB() {}
+  CRGB(uint8_t red, uint8_t green, uint8_t blue) : r(red), g(green), b(blue) {}
+  CRGB(uint32_t code) : r(code >> 16), g(code >> 8), b(code) {}
+  CRGB(HTMLColorCode code) : CRGB((uint32_t)code) {}
+  CRGB(const CHSV &hsv);
+
+  CRGB &nscale8(uint8_t scale);
+  CRGB &nscale8_video(uint8_t scale);
+  CRGB &fadeToBlackBy(uint8_t amount) { return nscale8(255 - amount); }
+
+  uint8_t &operator[](uint8_t index) { return raw[index]; }
+  const uint8_t &operator[](uint8_t index) const { return raw[index]; }
+  bool operator==(const CRGB &other) const { return r == other.r && g == other.g && b == other.b; }
+  bool operator!=(const CRGB &other) const { return !(*this == other); }
+};
+
+uint8_t scale8(uint8_t value, fract8 scale);
+uint8_t scale8_video(uint8_t value, fract8 scale);
+uint8_t qadd8(uint8_t a, uint8_t b);
+uint8_t qsub8(uint8_t a, uint8_t b);
+uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 amount);
+uint8_t sin8(uint8_t theta);
+uint8_t triwave8(uint8_t in);
+
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb);
+CRGB blend(const CRGB &a, const CRGB &b, fract8 amount);
+void fill_solid(CRGB *leds, int count, const CRGB &color);
+void fill_rainbow(CRGB *leds, int count, uint8_t hue, uint8_t delta = 5);
+void nscale8(CRGB *leds, uint16_t count, uint8_t scale);
+void fadeToBlackBy(CRGB *leds, uint16_t count, uint8_t amount);
+
+enum EOrder
+{
+  RGB = 0012,
+  GRB = 0102,
+  BRG = 0201
+};
+
+class CLEDController
+{
+public:
+  void setLeds(CRGB *data, int count)
+  {
+    leds = data;
+    length = count;
+  }
+
+private:
+  CRGB *leds = NULL;
+  int length = 0;
+};
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2812B : public CLEDController
+{
+};
+
+class CFastLED
+{
+public:
+  // One controller per chipset, pin and order, as in FastLED
+  template <template <uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+  static CLEDController &addLeds(CRGB *data, int count)
+  {
+    static CHIPSET<DATA_PIN, RGB_ORDER> controller;
+    controller.setLeds(data, count);
+    return controller;
+  }
+
+  void setBrightness(uint8_t scale) { brightness = scale; }
+  uint8_t getBrightness() { return brightness; }
+  void show() {}
+
+private:
+  uint8_t brightness = 255;
+};
+
+extern CFastLED FastLED;
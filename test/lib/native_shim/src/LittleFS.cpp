@@ -0,0 +1,34 @@
+#include "LittleFS.h"
+
+LittleFSFS LittleFS;
+
+File LittleFSFS::open(const char *path, const char *mode)
+{
+  auto found = files.find(path);
+  if (mode[0] == 'w')
+  {
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    files[path] = data;
+    return File(data);
+  }
+  return found == files.end() ? File() : File(found->second);
+}
+
+size_t File::read(uint8_t *buffer, size_t length)
+{
+  if (!data || position >= data->size())
+    return 0;
+  size_t count = min(length, data->size() - position);
+  memcpy(buffer, data->data() + position, count);
+  position += count;
+  return count;
+}
+
+size_t File::write(const uint8_t *buffer, size_t length)
+{
+  if (!data)
+    return 0;
+  data->insert(data->end(), buffer, buffer + length);
+  position = data->size();
+  return length;
+}
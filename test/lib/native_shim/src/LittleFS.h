@@ -0,0 +1,40 @@
+#pragma once
+
+// A file system in RAM, empty at start. Files opened for writing are
+// truncated; reads and writes move one position, as on the device.
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class File
+{
+public:
+  File() {}
+  File(std::shared_ptr<std::vector<uint8_t>> data) : data(data) {}
+  explicit operator bool() const { return data != nullptr; }
+  size_t read(uint8_t *buffer, size_t length);
+  size_t write(const uint8_t *buffer, size_t length);
+  size_t size() const { return data ? data->size() : 0; }
+  void close() { data = nullptr; }
+
+private:
+  std::shared_ptr<std::vector<uint8_t>> data;
+  size_t position = 0;
+};
+
+class LittleFSFS
+{
+public:
+  bool begin(bool formatOnFail = false) { return true; }
+  bool exists(const char *path) { return files.count(path) > 0; }
+  bool remove(const char *path) { return files.erase(path) > 0; }
+  File open(const char *path, const char *mode);
+
+private:
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+};
+
+extern LittleFSFS LittleFS;
@@ -0,0 +1,54 @@
+#include "Preferences.h"
+
+bool Preferences::clear()
+{
+  entries.clear();
+  writeCount++;
+  return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+  writeCount++;
+  return entries.erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+  return entries.count(key) > 0;
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+  auto entry = entries.find(key);
+  return entry == entries.end() ? 0 : entry->second.size();
+}
+
+// Like the ESP32 library, a value that does not fit reads as nothing
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength)
+{
+  auto entry = entries.find(key);
+  if (entry == entries.end() || entry->second.size() > maxLength)
+    return 0;
+  memcpy(buffer, entry->second.data(), entry->second.size());
+  return entry->second.size();
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+  const uint8_t *bytes = (const uint8_t *)value;
+  entries[key].assign(bytes, bytes + length);
+  writeCount++;
+  return length;
+}
+
+// Strings are stored with their terminator, as NVS does
+size_t Preferences::getString(const char *key, char *value, size_t maxLength)
+{
+  return getBytes(key, value, maxLength);
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+  return putBytes(key, value, strlen(value) + 1);
+}
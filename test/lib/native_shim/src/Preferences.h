@@ -0,0 +1,31 @@
+#pragma once
+
+// NVS in a map. writes() is not in the real API: it counts put calls, so
+// tests can see how often flash would be written.
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences
+{
+public:
+  bool begin(const char *name, bool readOnly = false) { return true; }
+  void end() {}
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buffer, size_t maxLength);
+  size_t putBytes(const char *key, const void *value, size_t length);
+  size_t getString(const char *key, char *value, size_t maxLength);
+  size_t putString(const char *key, const char *value);
+
+  uint32_t writes() const { return writeCount; }
+
+private:
+  std::map<std::string, std::vector<uint8_t>> entries;
+  uint32_t writeCount = 0;
+};
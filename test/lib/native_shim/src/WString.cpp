@@ -0,0 +1,74 @@
+#include "WString.h"
+#include <stdlib.h>
+#include <string.h>
+
+String::String(const char *text)
+{
+  assign(text, text != NULL ? strlen(text) : 0);
+}
+
+String::String(const char *text, size_t length)
+{
+  assign(text, length);
+}
+
+String::String(const String &other)
+{
+  assign(other.buffer, other.size);
+}
+
+String::String(String &&other) : buffer(other.buffer), size(other.size)
+{
+  other.buffer = NULL;
+  other.size = 0;
+}
+
+String::~String()
+{
+  free(buffer);
+}
+
+String &String::operator=(const String &other)
+{
+  if (this != &other)
+    assign(other.buffer, other.size);
+  return *this;
+}
+
+String &String::operator=(String &&other)
+{
+  if (this != &other)
+  {
+    free(buffer);
+    buffer = other.buffer;
+    size = other.size;
+    other.buffer = NULL;
+    other.size = 0;
+  }
+  return *this;
+}
+
+long String::toInt() const
+{
+  return buffer != NULL ? atol(buffer) : 0;
+}
+
+bool String::operator==(const char *text) const
+{
+  return strcmp(c_str(), text != NULL ? text : "") == 0;
+}
+
+void String::assign(const char *text, size_t length)
+{
+  free(buffer);
+  buffer = NULL;
+  size = 0;
+  if (text == NULL || length == 0)
+    return;
+  buffer = (char *)malloc(length + 1);
+  if (buffer == NULL)
+    return;
+  memcpy(buffer, text, length);
+  buffer[length] = '\0';
+  size = length;
+}
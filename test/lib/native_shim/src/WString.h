@@ -0,0 +1,34 @@
+#pragma once
+
+// Arduino's String, as far as main.cpp uses it. Every non-empty value
+// lives in its own heap block, so String temporaries show up in the heap
+// counters the same way they would on the device.
+
+#include <stddef.h>
+
+class String
+{
+public:
+  String(const char *text = "");
+  String(const char *text, size_t length);
+  String(const String &other);
+  String(String &&other);
+  ~String();
+  String &operator=(const String &other);
+  String &operator=(String &&other);
+
+  const char *c_str() const { return buffer != NULL ? buffer : ""; }
+  size_t length() const { return size; }
+  long toInt() const;
+
+  bool operator==(const char *text) const;
+  bool operator!=(const char *text) const { return !(*this == text); }
+  bool operator==(const String &other) const { return *this == other.c_str(); }
+  bool operator!=(const String &other) const { return !(*this == other.c_str()); }
+
+private:
+  void assign(const char *text, size_t length);
+
+  char *buffer = NULL;
+  size_t size = 0;
+};
@@ -0,0 +1,89 @@
+#include "WebServer.h"
+
+void WebServer::on(const char *uri, HTTPMethod method, THandlerFunction handler)
+{
+  if (routeCount == MAX_ROUTES)
+  {
+    printf("WebServer: more than %d routes, %s dropped\n", MAX_ROUTES, uri);
+    return;
+  }
+  routes[routeCount++] = {uri, method, handler};
+}
+
+// Uploads never arrive, only the final handler runs
+void WebServer::on(const char *uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler)
+{
+  on(uri, method, handler);
+}
+
+String WebServer::arg(const char *name)
+{
+  for (size_t i = 0; i < requestArgCount; i++)
+  {
+    if (strcmp(requestArgs[i].name, name) == 0)
+      return String(requestArgs[i].value);
+  }
+  return String();
+}
+
+bool WebServer::hasArg(const char *name)
+{
+  for (size_t i = 0; i < requestArgCount; i++)
+  {
+    if (strcmp(requestArgs[i].name, name) == 0)
+      return true;
+  }
+  return false;
+}
+
+void WebServer::send(int code, const char *contentType, const String &content)
+{
+  send_P(code, contentType, content.c_str(), content.length());
+}
+
+void WebServer::send_P(int code, const char *contentType, const char *content, size_t length)
+{
+  responseCode = code;
+  responseUsed = 0;
+  sendContent(content, length);
+}
+
+void WebServer::sendContent(const char *content, size_t length)
+{
+  size_t room = sizeof(response) - 1 - responseUsed;
+  if (length > room)
+  {
+    printf("WebServer: response over %d bytes cut off\n", MAX_RESPONSE_SIZE);
+    length = room;
+  }
+  memcpy(response + responseUsed, content, length);
+  responseUsed += length;
+  response[responseUsed] = '\0';
+}
+
+int WebServer::serve(HTTPMethod method, const char *uri, const RequestArg *args, size_t argCount)
+{
+  requestUri = uri;
+  requestMethod = method;
+  requestArgs = args;
+  requestArgCount = argCount;
+  responseCode = 0;
+  responseUsed = 0;
+  response[0] = '\0';
+
+  const THandlerFunction *handler = &notFoundHandler;
+  for (size_t i = 0; i < routeCount; i++)
+  {
+    if (strcmp(routes[i].uri, uri) == 0 && (routes[i].method == HTTP_ANY || routes[i].method == method))
+    {
+      handler = &routes[i].handler;
+      break;
+    }
+  }
+  if (*handler)
+    (*handler)();
+
+  requestArgs = NULL;
+  requestArgCount = 0;
+  return responseCode;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// The route table of the ESP32 WebServer without the network. Nothing
+// listens; a test hands requests to serve(), which runs the matching
+// handler in the calling thread and keeps the response in fixed buffers,
+// so serving adds no heap use of its own.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <functional>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define HTTP_UPLOAD_BUFLEN 1436
+#define MAX_ROUTES 48
+#define MAX_REQUEST_ARGS 8
+#define MAX_RESPONSE_SIZE 16384
+
+enum HTTPMethod
+{
+  HTTP_DELETE,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+  HTTP_ANY = 255
+};
+
+enum HTTPUploadStatus
+{
+  UPLOAD_FILE_START,
+  UPLOAD_FILE_WRITE,
+  UPLOAD_FILE_END,
+  UPLOAD_FILE_ABORTED
+};
+
+struct HTTPUpload
+{
+  HTTPUploadStatus status;
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
+
+// Name and value of a form field, "plain" carries a raw body
+struct RequestArg
+{
+  const char *name;
+  const char *value;
+};
+
+class WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  WebServer(int port = 80) {}
+  void begin() {}
+  void handleClient() {}
+  WiFiClient &client() { return currentClient; }
+
+  void on(const char *uri, HTTPMethod method, THandlerFunction handler);
+  void on(const char *uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler);
+  void onNotFound(THandlerFunction handler) { notFoundHandler = handler; }
+  void collectHeaders(const char *headerKeys[], size_t count) {}
+
+  String uri() { return String(requestUri); }
+  HTTPMethod method() { return requestMethod; }
+  String arg(const char *name);
+  bool hasArg(const char *name);
+  String header(const char *name) { return String(); } // Requests carry no headers
+  HTTPUpload &upload() { return currentUpload; }
+
+  void setContentLength(size_t length) {}
+  void sendHeader(const char *name, const char *value, bool first = false) {}
+  void send(int code, const char *contentType = NULL, const String &content = String());
+  void send_P(int code, const char *contentType, const char *content) { send_P(code, contentType, content, strlen(content)); }
+  void send_P(int code, const char *contentType, const char *content, size_t length);
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char *content, size_t length);
+
+  // Not in the real API: serves one request, returns the status code or 0
+  // if no handler answered. The body stays readable until the next request.
+  int serve(HTTPMethod method, const char *uri, const RequestArg *args = NULL, size_t argCount = 0);
+  const char *responseBody() const { return response; }
+  size_t responseLength() const { return responseUsed; }
+
+private:
+  struct Route
+  {
+    const char *uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  };
+
+  Route routes[MAX_ROUTES];
+  size_t routeCount = 0;
+  THandlerFunction notFoundHandler;
+  WiFiClient currentClient;
+  HTTPUpload currentUpload;
+
+  const char *requestUri = "";
+  HTTPMethod requestMethod = HTTP_GET;
+  const RequestArg *requestArgs = NULL;
+  size_t requestArgCount = 0;
+  int responseCode = 0;
+  char response[MAX_RESPONSE_SIZE];
+  size_t responseUsed = 0;
+};
@@ -0,0 +1,139 @@
+#include "WiFi.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+int WiFiClass::hostByName(const char *host, IPAddress &result)
+{
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  addrinfo *found = NULL;
+  if (getaddrinfo(host, NULL, &hints, &found) != 0 || found == NULL)
+    return 0;
+  uint32_t address = ((sockaddr_in *)found->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(found);
+  result = IPAddress(address, address >> 8, address >> 16, address >> 24);
+  return 1;
+}
+
+// Events come from the WiFi task on the device, here from the caller
+wl_status_t WiFiClass::begin(const char *ssid, const char *password)
+{
+  connectedToAP = true;
+  if (eventCallback != NULL)
+    eventCallback(ARDUINO_EVENT_WIFI_STA_GOT_IP, WiFiEventInfo_t());
+  return WL_CONNECTED;
+}
+
+bool WiFiClass::disconnect()
+{
+  if (!connectedToAP)
+    return false;
+  connectedToAP = false;
+  WiFiEventInfo_t info = {};
+  info.wifi_sta_disconnected.reason = 8; // Association left
+  if (eventCallback != NULL)
+    eventCallback(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, info);
+  return true;
+}
+
+size_t IPAddress::printTo(Print &out) const
+{
+  return out.printf("%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+}
+
+WiFiClient::Socket::~Socket()
+{
+  if (fd >= 0)
+    close(fd);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs)
+{
+  stop();
+  int sock = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return 0;
+  socket = std::make_shared<Socket>();
+  socket->fd = sock;
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = (uint32_t)ip;
+
+  // Non-blocking connect so the timeout applies, like the ESP32 client
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+  int result = ::connect(sock, (sockaddr *)&address, sizeof(address));
+  if (result != 0 && errno == EINPROGRESS)
+  {
+    pollfd waiting = {sock, POLLOUT, 0};
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (poll(&waiting, 1, timeoutMs) == 1 && getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length) == 0)
+      result = error == 0 ? 0 : -1;
+  }
+  if (result != 0)
+  {
+    stop();
+    return 0;
+  }
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+  return 1;
+}
+
+size_t WiFiClient::print(const char *text)
+{
+  int sock = fd();
+  if (sock < 0)
+    return 0;
+  ssize_t sent = send(sock, text, strlen(text), MSG_NOSIGNAL);
+  return sent > 0 ? sent : 0;
+}
+
+int WiFiClient::available()
+{
+  int count = 0;
+  int sock = fd();
+  if (sock < 0 || ioctl(sock, FIONREAD, &count) != 0)
+    return 0;
+  return count;
+}
+
+// Still true while received data is unread, like the ESP32 client
+uint8_t WiFiClient::connected()
+{
+  int sock = fd();
+  if (sock < 0)
+    return 0;
+  char byte;
+  ssize_t result = recv(sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return result > 0 || (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size)
+{
+  int sock = fd();
+  if (sock < 0)
+    return -1;
+  ssize_t result = recv(sock, buffer, size, MSG_DONTWAIT);
+  return result > 0 ? result : -1;
+}
+
+int WiFiClient::read()
+{
+  uint8_t byte;
+  return read(&byte, 1) == 1 ? byte : -1;
+}
+
+void WiFiClient::stop()
+{
+  socket = nullptr;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+// The ESP32 WiFi library on POSIX sockets. Clients talk to local stub
+// servers, the host is always online: begin() reports an IP right away and
+// scans find nothing. No access point or server accepts connections.
+
+#include <Arduino.h>
+#include <memory>
+
+class IPAddress : public Printable
+{
+public:
+  IPAddress() : address(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+  operator uint32_t() const { return address; } // Network byte order, as on the ESP32
+  uint8_t operator[](int index) const { return address >> (8 * index); }
+  size_t printTo(Print &out) const override;
+
+private:
+  uint32_t address;
+};
+
+// Copies share the socket, which closes once the last copy lets go
+class WiFiClient
+{
+public:
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  size_t print(const char *text);
+  int available();
+  uint8_t connected();
+  int read(uint8_t *buffer, size_t size);
+  int read();
+  void stop();
+  int fd() const { return socket ? socket->fd : -1; }
+  operator bool() { return connected(); }
+
+private:
+  struct Socket
+  {
+    int fd = -1;
+    ~Socket();
+  };
+  std::shared_ptr<Socket> socket;
+};
+
+class WiFiServer
+{
+public:
+  WiFiServer(uint16_t port) {}
+  void begin() {}
+  WiFiClient available() { return WiFiClient(); }
+};
+
+typedef enum
+{
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+  WIFI_OFF,
+  WIFI_STA,
+  WIFI_AP,
+  WIFI_AP_STA
+} wifi_mode_t;
+
+typedef enum
+{
+  WIFI_AUTH_OPEN,
+  WIFI_AUTH_WPA2_PSK = 3
+} wifi_auth_mode_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+typedef enum
+{
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7
+} WiFiEvent_t;
+
+typedef union
+{
+  struct
+  {
+    uint8_t reason;
+  } wifi_sta_disconnected;
+} WiFiEventInfo_t;
+
+typedef void (*WiFiEventFuncCb)(WiFiEvent_t event, WiFiEventInfo_t info);
+
+class WiFiClass
+{
+public:
+  int hostByName(const char *host, IPAddress &result);
+
+  bool mode(wifi_mode_t mode) { return true; }
+  bool softAP(const char *ssid, const char *password) { return true; }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  wl_status_t begin(const char *ssid, const char *password);
+  bool disconnect();
+  wl_status_t status() { return connectedToAP ? WL_CONNECTED : WL_DISCONNECTED; }
+  IPAddress localIP() { return connectedToAP ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+  int8_t RSSI() { return connectedToAP ? -50 : 0; }
+  void onEvent(WiFiEventFuncCb callback) { eventCallback = callback; }
+
+  int16_t scanNetworks(bool async = false) { return async ? WIFI_SCAN_RUNNING : 0; }
+  int16_t scanComplete() { return 0; }
+  void scanDelete() {}
+  String SSID(uint8_t index) { return String(); }
+  int8_t RSSI(uint8_t index) { return 0; }
+  wifi_auth_mode_t encryptionType(uint8_t index) { return WIFI_AUTH_OPEN; }
+
+private:
+  bool connectedToAP = false;
+  WiFiEventFuncCb eventCallback = NULL;
+};
+
+extern WiFiClass WiFi;
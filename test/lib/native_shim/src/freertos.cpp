@@ -0,0 +1,149 @@
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Storage is reserved at creation like in FreeRTOS, so sending and
+// receiving never touch the heap
+struct NativeQueue
+{
+  std::mutex lock;
+  std::condition_variable changed;
+  std::vector<uint8_t> storage;
+  size_t length;
+  size_t itemSize;
+  size_t head = 0; // Oldest item
+  size_t count = 0;
+};
+
+// Notification value of one task
+struct NativeTask
+{
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t value = 0;
+};
+
+static thread_local NativeTask *currentTask = NULL;
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stackDepth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+  NativeTask *created = new NativeTask;
+  if (handle != NULL)
+    *handle = created;
+  std::thread([task, param, created]()
+              {
+                currentTask = created;
+                task(param);
+              })
+      .detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+  return xTaskCreate(task, name, stackDepth, param, priority, handle);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  if (currentTask == NULL)
+    currentTask = new NativeTask;
+  return currentTask;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+  NativeTask *target = (NativeTask *)task;
+  std::lock_guard<std::mutex> held(target->lock);
+  target->value++;
+  target->notified.notify_all();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait)
+{
+  NativeTask *task = (NativeTask *)xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> held(task->lock);
+  auto ready = [task] { return task->value != 0; };
+  if (wait == portMAX_DELAY)
+    task->notified.wait(held, ready);
+  else
+    task->notified.wait_for(held, std::chrono::milliseconds(wait), ready);
+
+  uint32_t value = task->value;
+  if (value != 0)
+    task->value = clearOnExit ? 0 : value - 1;
+  return value;
+}
+
+// Waits until ready() holds, portMAX_DELAY waits forever
+template <typename Ready>
+static bool waitFor(NativeQueue *queue, std::unique_lock<std::mutex> &held, TickType_t wait, Ready ready)
+{
+  if (wait == portMAX_DELAY)
+  {
+    queue->changed.wait(held, ready);
+    return true;
+  }
+  return queue->changed.wait_for(held, std::chrono::milliseconds(wait), ready);
+}
+
+static void pushItem(NativeQueue *queue, const void *item)
+{
+  size_t slot = (queue->head + queue->count) % queue->length;
+  if (queue->itemSize > 0)
+    memcpy(queue->storage.data() + slot * queue->itemSize, item, queue->itemSize);
+  queue->count++;
+  queue->changed.notify_all();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  NativeQueue *queue = new NativeQueue;
+  queue->length = length;
+  queue->itemSize = itemSize;
+  queue->storage.resize(length * itemSize);
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+  std::unique_lock<std::mutex> held(queue->lock);
+  if (!waitFor(queue, held, wait, [queue] { return queue->count < queue->length; }))
+    return pdFALSE;
+  pushItem(queue, item);
+  return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+  std::lock_guard<std::mutex> held(queue->lock);
+  queue->head = 0; // Only meant for queues of length one
+  queue->count = 0;
+  pushItem(queue, item);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+  std::unique_lock<std::mutex> held(queue->lock);
+  if (!waitFor(queue, held, wait, [queue] { return queue->count > 0; }))
+    return pdFALSE;
+  if (queue->itemSize > 0)
+    memcpy(item, queue->storage.data() + queue->head * queue->itemSize, queue->itemSize);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  queue->changed.notify_all();
+  return pdTRUE;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// FreeRTOS on threads: one tick per millisecond, tasks are detached
+// std::threads, queues are guarded by a mutex. Priorities and core
+// affinity are ignored.
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// Spinlock of the ESP32 port, for the few lines it guards a spin is fine
+typedef struct
+{
+  volatile int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) while (__atomic_exchange_n(&(mux)->owner, 1, __ATOMIC_ACQUIRE)) {}
+#define portEXIT_CRITICAL(mux) __atomic_store_n(&(mux)->owner, 0, __ATOMIC_RELEASE)
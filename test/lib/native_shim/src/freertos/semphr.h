@@ -0,0 +1,11 @@
+#pragma once
+
+// Binary semaphores are queues of empty items, as in FreeRTOS itself
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define xSemaphoreTake(semaphore, wait) xQueueReceive(semaphore, NULL, wait)
+#define xSemaphoreGive(semaphore) xQueueSend(semaphore, NULL, 0)
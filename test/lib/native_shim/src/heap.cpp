@@ -0,0 +1,126 @@
+#include "Arduino.h"
+
+// Counts the bytes handed out by malloc and friends, so tests can see what
+// the firmware leaves on the heap. The wrappers forward to glibc's own
+// allocator (2.33 or later for mallinfo2()); elsewhere nothing is counted
+// and the heap always looks untouched.
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+#include <errno.h>
+#include <malloc.h>
+#include <atomic>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *block, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void __libc_free(void *block);
+
+static std::atomic<size_t> liveBytes(0);
+static std::atomic<size_t> peakBytes(0);
+
+static void *counted(void *block)
+{
+  if (block == NULL)
+    return NULL;
+  size_t live = liveBytes += malloc_usable_size(block);
+  size_t peak = peakBytes;
+  while (live > peak && !peakBytes.compare_exchange_weak(peak, live))
+  {
+  }
+  return block;
+}
+
+static void uncount(void *block)
+{
+  if (block != NULL)
+    liveBytes -= malloc_usable_size(block);
+}
+
+extern "C" void *malloc(size_t size) noexcept
+{
+  return counted(__libc_malloc(size));
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+  return counted(__libc_calloc(count, size));
+}
+
+extern "C" void *realloc(void *block, size_t size) noexcept
+{
+  size_t before = block != NULL ? malloc_usable_size(block) : 0;
+  void *moved = __libc_realloc(block, size);
+  if (moved == NULL && size != 0)
+    return NULL; // Failed, the old block is still there
+  liveBytes -= before;
+  return counted(moved);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) noexcept
+{
+  return counted(__libc_memalign(alignment, size));
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+  return memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **result, size_t alignment, size_t size) noexcept
+{
+  void *block = memalign(alignment, size);
+  if (block == NULL)
+    return ENOMEM;
+  *result = block;
+  return 0;
+}
+
+extern "C" void free(void *block) noexcept
+{
+  uncount(block);
+  __libc_free(block);
+}
+
+static uint32_t nominalFree(size_t used)
+{
+  return used < NATIVE_HEAP_SIZE ? NATIVE_HEAP_SIZE - used : 0;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+  return nominalFree(liveBytes);
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+  return nominalFree(peakBytes);
+}
+
+// Stands in for the largest free block: the free top of glibc's main heap.
+// Everything below it counts as taken, holes left by freed blocks too, so
+// the figure drops when leftovers pin the heap up and fragment it.
+uint32_t EspClass::getMaxAllocHeap()
+{
+  struct mallinfo2 info = mallinfo2();
+  return nominalFree(info.arena - info.keepcost);
+}
+
+#else
+
+uint32_t EspClass::getFreeHeap()
+{
+  return NATIVE_HEAP_SIZE;
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+  return NATIVE_HEAP_SIZE;
+}
+
+uint32_t EspClass::getMaxAllocHeap()
+{
+  return NATIVE_HEAP_SIZE;
+}
+
+#endif
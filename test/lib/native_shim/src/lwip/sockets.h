@@ -0,0 +1,13 @@
+#pragma once
+
+// lwip's BSD socket API is the host's own
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Range of descriptors lwip hands out, here the first ones of the process
+#define LWIP_SOCKET_OFFSET 0
+#define CONFIG_LWIP_MAX_SOCKETS 64
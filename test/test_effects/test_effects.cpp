@@ -0,0 +1,214 @@
+// Frame output of the effects and the status effect transitions the
+// internet check drives. Runs on the host: pio test -e native
+
+#include <unity.h>
+#include "effects.h"
+#include "compositor.h"
+
+#define STRIP_LENGTH 10
+#define CANARY CRGB(1, 2, 3)
+
+static const EffectSettings settings = {CRGB(0, 0, 255), CRGB(255, 0, 0)};
+
+static CRGB leds[STRIP_LENGTH + 1]; // One extra pixel catches writes past the end
+static EffectState state;
+
+void setUp()
+{
+  fill_solid(leds, STRIP_LENGTH, CRGB::Black);
+  leds[STRIP_LENGTH] = CANARY;
+  state = {};
+}
+
+void tearDown()
+{
+}
+
+static void render(EffectId id, uint32_t now, uint32_t elapsed, int count = STRIP_LENGTH)
+{
+  EffectFrame frame = {leds, count, now, elapsed, &state};
+  renderEffect(id, frame, settings);
+}
+
+static bool allPixels(const CRGB &color)
+{
+  for (int i = 0; i < STRIP_LENGTH; i++)
+  {
+    if (leds[i] != color)
+      return false;
+  }
+  return true;
+}
+
+void test_snake_bounces_between_both_ends()
+{
+  // One pixel per EFFECT_STEP_MS, so one step per frame here
+  int previous = -1;
+  int direction = 0;
+  bool reachedStart = false;
+  bool reachedEnd = false;
+  for (uint32_t frame = 0; frame < 4 * STRIP_LENGTH; frame++)
+  {
+    render(EFFECT_SNAKE, frame * EFFECT_STEP_MS, EFFECT_STEP_MS);
+    int head = state.snakePosition;
+    TEST_ASSERT_GREATER_OR_EQUAL(0, head);
+    TEST_ASSERT_LESS_THAN(STRIP_LENGTH, head);
+    TEST_ASSERT_TRUE(leds[head] == settings.snakeColor);
+
+    if (previous >= 0)
+    {
+      int moved = head - previous;
+      TEST_ASSERT_EQUAL_INT(1, abs(moved)); // Never jumps or stands still
+      if (direction != 0 && moved != direction)
+        TEST_ASSERT_TRUE(previous == 0 || previous == STRIP_LENGTH - 1); // Turns only at the ends
+      direction = moved;
+    }
+    reachedStart |= head == 0;
+    reachedEnd |= head == STRIP_LENGTH - 1;
+    previous = head;
+  }
+  TEST_ASSERT_TRUE(reachedStart);
+  TEST_ASSERT_TRUE(reachedEnd);
+  TEST_ASSERT_TRUE(leds[STRIP_LENGTH] == CANARY);
+}
+
+void test_snake_trail_fades_behind_the_head()
+{
+  for (uint32_t frame = 0; frame < 5; frame++)
+    render(EFFECT_SNAKE, frame * EFFECT_STEP_MS, EFFECT_STEP_MS);
+
+  // Head at 4, the previous frame's head is drawn again to close the gap
+  TEST_ASSERT_EQUAL_INT(4, state.snakePosition);
+  TEST_ASSERT_TRUE(leds[4] == settings.snakeColor);
+  TEST_ASSERT_TRUE(leds[3] == settings.snakeColor);
+  TEST_ASSERT_LESS_THAN(leds[3].r, leds[2].r);
+  TEST_ASSERT_LESS_THAN(leds[2].r, leds[1].r);
+  TEST_ASSERT_TRUE(leds[5] == CRGB(CRGB::Black));
+}
+
+void test_snake_fills_pixels_skipped_by_a_slow_frame()
+{
+  render(EFFECT_SNAKE, 0, EFFECT_STEP_MS);
+  render(EFFECT_SNAKE, 3 * EFFECT_STEP_MS, 3 * EFFECT_STEP_MS);
+
+  TEST_ASSERT_EQUAL_INT(3, state.snakePosition);
+  for (int i = 0; i <= 3; i++)
+    TEST_ASSERT_TRUE(leds[i] == settings.snakeColor);
+}
+
+void test_snake_does_not_smear_after_a_stall()
+{
+  render(EFFECT_SNAKE, 0, EFFECT_STEP_MS);
+  render(EFFECT_SNAKE, 10 * EFFECT_STEP_MS, 10 * EFFECT_STEP_MS);
+
+  // 10 steps on a 10 pixel strip: out to 9 and back to 8
+  TEST_ASSERT_EQUAL_INT(8, state.snakePosition);
+  for (int i = 0; i < STRIP_LENGTH; i++)
+    TEST_ASSERT_TRUE(leds[i] == (i == 8 ? settings.snakeColor : CRGB(CRGB::Black)));
+}
+
+void test_breathe_stays_within_its_brightness_bounds()
+{
+  const CRGB dimmest = CHSV(effectRegistry[EFFECT_BREATHE_GREEN].params.hue, 255, 50);
+  const CRGB brightest = CHSV(effectRegistry[EFFECT_BREATHE_GREEN].params.hue, 255, 255);
+  uint8_t low = 255;
+  uint8_t high = 0;
+
+  // A bit more than one full cycle, 50 to 255 and back at 3 per step
+  for (uint32_t now = 0; now < 8000; now += 10)
+  {
+    render(EFFECT_BREATHE_GREEN, now, 10);
+    TEST_ASSERT_TRUE(allPixels(leds[0]));
+    TEST_ASSERT_EQUAL_UINT8(0, leds[0].r);
+    TEST_ASSERT_GREATER_OR_EQUAL(dimmest.g, leds[0].g);
+    TEST_ASSERT_LESS_OR_EQUAL(brightest.g, leds[0].g);
+    low = min(low, leds[0].g);
+    high = max(high, leds[0].g);
+  }
+  TEST_ASSERT_EQUAL_UINT8(dimmest.g, low);
+  TEST_ASSERT_EQUAL_UINT8(brightest.g, high);
+  TEST_ASSERT_TRUE(leds[STRIP_LENGTH] == CANARY);
+}
+
+void test_blink_toggles_every_period()
+{
+  const uint32_t period = effectRegistry[EFFECT_BLINK_RED].params.periodMs;
+  for (uint32_t now = 0; now < 4 * period; now += 10)
+  {
+    render(EFFECT_BLINK_RED, now, 10);
+    bool on = (now / period) % 2 == 1;
+    TEST_ASSERT_TRUE(allPixels(on ? CRGB(CRGB::Red) : CRGB(CRGB::Black)));
+  }
+}
+
+void test_blink_follows_the_clock_not_the_frame_rate()
+{
+  const uint32_t period = effectRegistry[EFFECT_BLINK_RED].params.periodMs;
+  render(EFFECT_BLINK_RED, period + 5, period + 5); // One slow frame
+  TEST_ASSERT_TRUE(allPixels(CRGB::Red));
+  render(EFFECT_BLINK_RED, 2 * period - 1, 1);
+  TEST_ASSERT_TRUE(allPixels(CRGB::Red));
+  render(EFFECT_BLINK_RED, 2 * period, 1);
+  TEST_ASSERT_TRUE(allPixels(CRGB::Black));
+}
+
+void test_status_effect_follows_the_internet_check()
+{
+  // First result after boot
+  TEST_ASSERT_EQUAL(EFFECT_BREATHE_GREEN, statusEffect(EFFECT_CHECKING, true, false));
+  TEST_ASSERT_EQUAL(EFFECT_BLINK_RED, statusEffect(EFFECT_CHECKING, false, false));
+
+  // Green to red and back, through amber while degraded
+  TEST_ASSERT_EQUAL(EFFECT_BLINK_RED, statusEffect(EFFECT_BREATHE_GREEN, false, false));
+  TEST_ASSERT_EQUAL(EFFECT_BREATHE_GREEN, statusEffect(EFFECT_BLINK_RED, true, false));
+  TEST_ASSERT_EQUAL(EFFECT_BREATHE_AMBER, statusEffect(EFFECT_BREATHE_GREEN, true, true));
+  TEST_ASSERT_EQUAL(EFFECT_BLINK_RED, statusEffect(EFFECT_BREATHE_AMBER, false, false));
+  TEST_ASSERT_EQUAL(EFFECT_BREATHE_GREEN, statusEffect(EFFECT_BREATHE_AMBER, true, false));
+}
+
+void test_user_effects_are_left_alone_by_the_internet_check()
+{
+  for (uint8_t id = 0; id < EFFECT_COUNT; id++)
+  {
+    if (effectRegistry[id].flags & EFFECT_STATUS)
+      continue;
+    TEST_ASSERT_EQUAL(id, statusEffect((EffectId)id, false, false));
+    TEST_ASSERT_EQUAL(id, statusEffect((EffectId)id, true, true));
+  }
+}
+
+void test_user_effects_get_an_overlay_instead()
+{
+  TEST_ASSERT_EQUAL(OVERLAY_OFFLINE, statusOverlay(false, false, false));
+  TEST_ASSERT_EQUAL(OVERLAY_DEGRADED, statusOverlay(false, true, true));
+  TEST_ASSERT_EQUAL(OVERLAY_NONE, statusOverlay(false, true, false));
+  TEST_ASSERT_EQUAL(OVERLAY_NONE, statusOverlay(true, false, false)); // The status effect already shows it
+}
+
+void test_every_effect_stays_inside_its_frame()
+{
+  for (uint8_t id = 0; id < EFFECT_COUNT; id++)
+  {
+    state = {};
+    for (uint32_t now = 0; now < 2000; now += 50)
+      render((EffectId)id, now, 50);
+    TEST_ASSERT_TRUE_MESSAGE(leds[STRIP_LENGTH] == CANARY, effectRegistry[id].name);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_snake_bounces_between_both_ends);
+  RUN_TEST(test_snake_trail_fades_behind_the_head);
+  RUN_TEST(test_snake_fills_pixels_skipped_by_a_slow_frame);
+  RUN_TEST(test_snake_does_not_smear_after_a_stall);
+  RUN_TEST(test_breathe_stays_within_its_brightness_bounds);
+  RUN_TEST(test_blink_toggles_every_period);
+  RUN_TEST(test_blink_follows_the_clock_not_the_frame_rate);
+  RUN_TEST(test_status_effect_follows_the_internet_check);
+  RUN_TEST(test_user_effects_are_left_alone_by_the_internet_check);
+  RUN_TEST(test_user_effects_get_an_overlay_instead);
+  RUN_TEST(test_every_effect_stays_inside_its_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,221 @@
+// The probe engine against a local stub HTTP server: the render loop keeps
+// its frame cadence while a probe is pending, probe results drive the
+// green/red status effects with the engine's hysteresis, and each target
+// only counts the answer its check is meant to give.
+// Runs on the host: pio test -e native
+
+#include <unity.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "effects.h"
+#include "probe.h"
+
+#define FRAME_PERIOD_MS 20 // 50 FPS
+#define STUB_DELAY_MS 500  // Time the stub takes to answer, longer than many frames
+#define STRIP_LENGTH 300
+
+static const char *NO_CONTENT = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+static const char *PORTAL_PAGE = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n<html>Sign in to the hotel WiFi</html>";
+
+static Preferences prefs;
+static int stubSocket = -1;
+static uint16_t stubPort = 0;
+static std::atomic<const char *> stubResponse(NO_CONTENT);
+static std::atomic<uint32_t> stubDelayMs(0);
+
+// Answers every connection with stubResponse after stubDelayMs, then closes
+static void runStub()
+{
+  for (;;)
+  {
+    int client = accept(stubSocket, NULL, NULL);
+    if (client < 0)
+      return;
+    char request[512];
+    recv(client, request, sizeof(request), 0);
+    delay(stubDelayMs);
+    const char *response = stubResponse;
+    send(client, response, strlen(response), MSG_NOSIGNAL);
+    close(client);
+  }
+}
+
+static void startStub()
+{
+  stubSocket = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(stubSocket, (sockaddr *)&address, length) != 0 || listen(stubSocket, 4) != 0 ||
+      getsockname(stubSocket, (sockaddr *)&address, &length) != 0)
+  {
+    perror("stub server");
+    exit(1);
+  }
+  stubPort = ntohs(address.sin_port);
+  std::thread(runStub).detach();
+}
+
+// Waits for the pending probe without rendering
+static ProbeResult waitForProbe()
+{
+  ProbeResult result = {};
+  uint32_t start = millis();
+  while (!pollProbeResult(result))
+  {
+    TEST_ASSERT_LESS_THAN_MESSAGE(5000, millis() - start, "probe never finished");
+    delay(1);
+  }
+  return result;
+}
+
+static ProbeResult probeOnce(const char *response)
+{
+  stubResponse = response;
+  TEST_ASSERT_TRUE(requestProbe());
+  return waitForProbe();
+}
+
+static EffectId statusAfterProbe(EffectId current)
+{
+  InternetState state = internetState();
+  return statusEffect(current, state == INTERNET_ONLINE || state == INTERNET_DEGRADED, state == INTERNET_DEGRADED);
+}
+
+void setUp()
+{
+  stubDelayMs = 0;
+  stubResponse = NO_CONTENT;
+}
+
+void tearDown()
+{
+}
+
+void test_render_cadence_holds_while_a_probe_is_pending()
+{
+  static CRGB leds[STRIP_LENGTH];
+  EffectState state = {};
+  const EffectSettings settings = {CRGB::Green, CRGB::Red};
+  stubDelayMs = STUB_DELAY_MS;
+
+  // The render loop of the firmware in miniature: fixed deadlines, a probe
+  // requested along the way, results collected without waiting
+  uint32_t deadline = millis();
+  uint32_t lastFrame = deadline;
+  uint32_t worstInterval = 0;
+  uint32_t pendingFrames = 0;
+  bool finished = false;
+  ProbeResult result = {};
+  for (int frame = 0; frame < 2 * STUB_DELAY_MS / FRAME_PERIOD_MS; frame++)
+  {
+    if (frame == 5)
+      TEST_ASSERT_TRUE(requestProbe());
+
+    uint32_t now = millis();
+    EffectFrame effectFrame = {leds, STRIP_LENGTH, now, now - lastFrame, &state};
+    renderEffect(EFFECT_RAINBOW, effectFrame, settings);
+    if (frame > 0)
+      worstInterval = max(worstInterval, now - lastFrame);
+    lastFrame = now;
+
+    if (probePending())
+      pendingFrames++;
+    finished |= pollProbeResult(result);
+
+    deadline += FRAME_PERIOD_MS;
+    int32_t wait = deadline - millis();
+    if (wait > 0)
+      delay(wait);
+  }
+
+  TEST_ASSERT_TRUE(finished);
+  TEST_ASSERT_TRUE(result.success);
+  TEST_ASSERT_GREATER_OR_EQUAL(STUB_DELAY_MS, result.totalMs);
+  // The probe overlapped many frames, and none of them waited for it
+  TEST_ASSERT_GREATER_OR_EQUAL(STUB_DELAY_MS / FRAME_PERIOD_MS - 2, pendingFrames);
+  TEST_ASSERT_LESS_THAN(2 * FRAME_PERIOD_MS, worstInterval);
+}
+
+void test_probe_results_switch_between_green_and_red()
+{
+  // Settle online whatever the previous test left behind
+  for (int i = 0; i < PROBE_WINDOW; i++)
+    probeOnce(NO_CONTENT);
+  EffectId effect = statusAfterProbe(EFFECT_CHECKING);
+  TEST_ASSERT_EQUAL(EFFECT_BREATHE_GREEN, effect);
+
+  // A captive portal answering 200 is a failure, but one is not enough to flip
+  ProbeResult result = probeOnce(PORTAL_PAGE);
+  TEST_ASSERT_FALSE(result.success);
+  TEST_ASSERT_EQUAL(200, result.status);
+  effect = statusAfterProbe(effect);
+  TEST_ASSERT_EQUAL(EFFECT_BREATHE_GREEN, effect);
+
+  for (int i = 1; i < PROBE_FAILURES_OFFLINE; i++)
+    probeOnce(PORTAL_PAGE);
+  TEST_ASSERT_EQUAL(INTERNET_OFFLINE, internetState());
+  effect = statusAfterProbe(effect);
+  TEST_ASSERT_EQUAL(EFFECT_BLINK_RED, effect);
+
+  // Back once the failures have dropped out of the window
+  for (int i = 0; i < PROBE_WINDOW - PROBE_FAILURES_OFFLINE; i++)
+  {
+    probeOnce(NO_CONTENT);
+    TEST_ASSERT_EQUAL(EFFECT_BLINK_RED, statusAfterProbe(effect));
+  }
+  probeOnce(NO_CONTENT);
+  TEST_ASSERT_EQUAL(INTERNET_ONLINE, internetState());
+  effect = statusAfterProbe(effect);
+  TEST_ASSERT_EQUAL(EFFECT_BREATHE_GREEN, effect);
+}
+
+void test_connection_refused_counts_as_a_failure()
+{
+  char target[48];
+  snprintf(target, sizeof(target), "127.0.0.1:1/generate_204"); // Nothing listens on port 1
+  TEST_ASSERT_TRUE(setProbeTargets(prefs, target));
+
+  ProbeResult result = probeOnce(NO_CONTENT);
+  TEST_ASSERT_FALSE(result.success);
+  TEST_ASSERT_EQUAL(PROBE_ERROR_CONNECT, result.status);
+}
+
+void test_connecttest_needs_status_and_body()
+{
+  char target[48];
+  snprintf(target, sizeof(target), "127.0.0.1:%u/connecttest.txt", stubPort);
+  TEST_ASSERT_TRUE(setProbeTargets(prefs, target));
+
+  ProbeResult result = probeOnce("HTTP/1.1 200 OK\r\nContent-Length: 22\r\n\r\nMicrosoft Connect Test");
+  TEST_ASSERT_TRUE(result.success);
+
+  result = probeOnce(PORTAL_PAGE);
+  TEST_ASSERT_FALSE(result.success);
+  TEST_ASSERT_EQUAL(PROBE_ERROR_BODY, result.status);
+
+  result = probeOnce(NO_CONTENT); // Right for generate_204, wrong here
+  TEST_ASSERT_FALSE(result.success);
+  TEST_ASSERT_EQUAL(204, result.status);
+}
+
+int main(int argc, char **argv)
+{
+  startStub();
+  char target[48];
+  snprintf(target, sizeof(target), "127.0.0.1:%u/generate_204", stubPort);
+  beginProbe(prefs);
+  setProbeTargets(prefs, target);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_render_cadence_holds_while_a_probe_is_pending);
+  RUN_TEST(test_probe_results_switch_between_green_and_red);
+  RUN_TEST(test_connection_refused_counts_as_a_failure);
+  RUN_TEST(test_connecttest_needs_status_and_body);
+  return UNITY_END();
+}
@@ -0,0 +1,163 @@
+// Flash writes of the settings store under bursts of changes, on a frozen
+// clock. Runs on the host: pio test -e native
+
+#include <unity.h>
+#include "settings.h"
+
+static Preferences prefs;
+
+static DeviceSettings sample(uint8_t brightness)
+{
+  DeviceSettings settings = {};
+  settings.effect = EFFECT_SNAKE;
+  settings.fps = 40;
+  settings.brightness = brightness;
+  settings.speed = 150;
+  settings.staticColor = CRGB(0x12, 0x34, 0x56);
+  settings.snakeColor = CRGB(0xFF, 0x00, 0x80);
+  settings.segments[0] = {0, 200, EFFECT_SNAKE};
+  settings.segments[1] = {200, 100, EFFECT_RAINBOW};
+  return settings;
+}
+
+void setUp()
+{
+  prefs = Preferences();
+  discardSettings();
+  freezeClock(100000);
+}
+
+void tearDown()
+{
+}
+
+void test_nothing_is_written_without_changes()
+{
+  flushSettings(prefs);
+  advanceClock(SETTINGS_QUIET_PERIOD * 2);
+  flushSettings(prefs);
+  flushSettings(prefs, true);
+  TEST_ASSERT_EQUAL_UINT32(0, prefs.writes());
+}
+
+void test_a_burst_of_changes_is_written_once()
+{
+  uint32_t before = settingsFlashWrites();
+
+  // A dragged slider: a change every 100 ms for 5 s, loop() flushing in between
+  for (uint8_t brightness = 0; brightness < 50; brightness++)
+  {
+    updateSettings(sample(brightness));
+    advanceClock(100);
+    flushSettings(prefs);
+    TEST_ASSERT_EQUAL_UINT32(0, prefs.writes());
+  }
+
+  // The quiet period counts from the last change
+  advanceClock(SETTINGS_QUIET_PERIOD - 101);
+  flushSettings(prefs);
+  TEST_ASSERT_EQUAL_UINT32(0, prefs.writes());
+  advanceClock(1);
+  flushSettings(prefs);
+  TEST_ASSERT_EQUAL_UINT32(1, prefs.writes());
+
+  for (int i = 0; i < 10; i++)
+  {
+    advanceClock(SETTINGS_QUIET_PERIOD);
+    flushSettings(prefs);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, prefs.writes());
+  TEST_ASSERT_EQUAL_UINT32(before + 1, settingsFlashWrites());
+
+  // What was written is the last value of the burst
+  DeviceSettings loaded = {};
+  TEST_ASSERT_TRUE(loadSettings(prefs, loaded));
+  TEST_ASSERT_EQUAL_UINT8(49, loaded.brightness);
+}
+
+void test_an_unchanged_blob_is_not_written_again()
+{
+  updateSettings(sample(100));
+  flushSettings(prefs, true);
+  TEST_ASSERT_EQUAL_UINT32(1, prefs.writes());
+
+  // Same values again
+  updateSettings(sample(100));
+  advanceClock(SETTINGS_QUIET_PERIOD);
+  flushSettings(prefs);
+  TEST_ASSERT_EQUAL_UINT32(1, prefs.writes());
+
+  // Dragged away and back before the quiet period ended
+  updateSettings(sample(180));
+  advanceClock(500);
+  updateSettings(sample(100));
+  advanceClock(SETTINGS_QUIET_PERIOD);
+  flushSettings(prefs);
+  TEST_ASSERT_EQUAL_UINT32(1, prefs.writes());
+}
+
+void test_force_writes_without_waiting()
+{
+  updateSettings(sample(7));
+  flushSettings(prefs, true);
+  TEST_ASSERT_EQUAL_UINT32(1, prefs.writes());
+}
+
+void test_discarded_changes_are_not_written()
+{
+  updateSettings(sample(7));
+  discardSettings();
+  advanceClock(SETTINGS_QUIET_PERIOD);
+  flushSettings(prefs, true);
+  TEST_ASSERT_EQUAL_UINT32(0, prefs.writes());
+}
+
+void test_settings_load_back_as_written()
+{
+  DeviceSettings written = sample(42);
+  updateSettings(written);
+  flushSettings(prefs, true);
+
+  DeviceSettings loaded = {};
+  TEST_ASSERT_TRUE(loadSettings(prefs, loaded));
+  TEST_ASSERT_EQUAL_UINT8(written.effect, loaded.effect);
+  TEST_ASSERT_EQUAL_UINT8(written.fps, loaded.fps);
+  TEST_ASSERT_EQUAL_UINT8(written.brightness, loaded.brightness);
+  TEST_ASSERT_EQUAL_UINT16(written.speed, loaded.speed);
+  TEST_ASSERT_TRUE(written.staticColor == loaded.staticColor);
+  TEST_ASSERT_TRUE(written.snakeColor == loaded.snakeColor);
+  for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT16(written.segments[i].start, loaded.segments[i].start);
+    TEST_ASSERT_EQUAL_UINT16(written.segments[i].length, loaded.segments[i].length);
+    TEST_ASSERT_EQUAL(written.segments[i].effect, loaded.segments[i].effect);
+  }
+}
+
+void test_a_corrupted_blob_is_ignored()
+{
+  updateSettings(sample(42));
+  flushSettings(prefs, true);
+
+  uint8_t blob[SETTINGS_BLOB_SIZE];
+  TEST_ASSERT_EQUAL(SETTINGS_BLOB_SIZE, prefs.getBytes("settings", blob, sizeof(blob)));
+  blob[3] ^= 0x01; // Brightness, the checksum no longer matches
+  prefs.putBytes("settings", blob, sizeof(blob));
+
+  DeviceSettings loaded = sample(1);
+  TEST_ASSERT_FALSE(loadSettings(prefs, loaded));
+  TEST_ASSERT_EQUAL_UINT8(1, loaded.brightness); // Left untouched
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_is_written_without_changes);
+  RUN_TEST(test_a_burst_of_changes_is_written_once);
+  RUN_TEST(test_an_unchanged_blob_is_not_written_again);
+  RUN_TEST(test_force_writes_without_waiting);
+  RUN_TEST(test_discarded_changes_are_not_written);
+  RUN_TEST(test_settings_load_back_as_written);
+  RUN_TEST(test_a_corrupted_blob_is_ignored);
+  return UNITY_END();
+}
@@ -0,0 +1,150 @@
+// Soaks the web handlers of main.cpp: rounds of /status, /command and
+// /effect, accepted and rejected, must leave the heap as they found it.
+// The shim counts every malloc, so ESP.getFreeHeap() follows the live bytes
+// and ESP.getMaxAllocHeap() the largest-block figure; both have to come
+// back to their value after every round.
+// Runs on the host: pio test -e native
+
+#include <unity.h>
+#include <Preferences.h>
+#include <WebServer.h>
+#include "metrics.h"
+
+#define BOOT_TIMEOUT_MS 5000
+#define WARMUP_ROUNDS 20 // Lets glibc's per-size caches settle
+#define SOAK_ROUNDS 200
+#define MAX_SOAK_ARGS 3
+
+extern WebServer server;
+extern Preferences preferences;
+
+struct SoakRequest
+{
+  HTTPMethod method;
+  const char *uri;
+  RequestArg args[MAX_SOAK_ARGS]; // Up to the first NULL name
+  int code;
+};
+
+// One round, every path once. Segment 0 is shrunk to make room for
+// segment 1 and grown back once it is removed, so rounds repeat exactly.
+static const SoakRequest requests[] = {
+    {HTTP_GET, "/status", {}, 200},
+    {HTTP_POST, "/command", {{"plain", "{\"effect\":\"static\",\"color\":\"#FF8800\",\"speed\":150,\"brightness\":80}"}}, 200},
+    {HTTP_POST, "/command", {{"plain", "{\"length\":200}"}}, 200},
+    {HTTP_POST, "/command", {{"plain", "{\"segment\":1,\"start\":200,\"length\":100,\"effect\":\"snake\"}"}}, 200},
+    {HTTP_GET, "/status", {}, 200},
+    {HTTP_POST, "/command", {{"plain", "{\"segment\":1,\"length\":0}"}}, 200},
+    {HTTP_POST, "/command", {{"plain", "{\"length\":300,\"effect\":\"rainbow\",\"fps\":30}"}}, 200},
+    {HTTP_POST, "/command", {{"plain", "{\"speed\":5}"}}, 400},
+    {HTTP_POST, "/command", {{"plain", "{\"volume\":3}"}}, 400},
+    {HTTP_POST, "/command", {{"plain", "{\"segment\":2,\"start\":10,\"length\":5}"}}, 400},
+    {HTTP_POST, "/command", {{"plain", "[1,2,3]"}}, 400},
+    {HTTP_POST, "/effect", {{"effect", "snake"}, {"snakeColor", "#0000FF"}, {"fps", "25"}}, 200},
+    {HTTP_POST, "/effect", {{"effect", "static"}, {"color", "#00FF00"}}, 200},
+    {HTTP_POST, "/effect", {{"effect", "sparkle"}}, 400},
+    {HTTP_POST, "/effect", {{"effect", "static"}, {"color", "green"}}, 400},
+    {HTTP_POST, "/effect", {{"effect", "rainbow"}, {"fps", "500"}}, 400},
+    {HTTP_GET, "/", {}, 200},
+    {HTTP_GET, "/metrics", {}, 200},
+};
+
+static int serve(const SoakRequest &request)
+{
+  size_t argCount = 0;
+  while (argCount < MAX_SOAK_ARGS && request.args[argCount].name != NULL)
+    argCount++;
+  return server.serve(request.method, request.uri, request.args, argCount);
+}
+
+static void runRound()
+{
+  for (const SoakRequest &request : requests)
+    TEST_ASSERT_EQUAL_MESSAGE(request.code, serve(request), request.uri);
+}
+
+// Associates with the saved network and runs loop() until the monitoring
+// routes are up and the first probe is in, so the probe task has made its
+// allocations before anything is measured
+static bool boot()
+{
+  preferences.putString("ssid", "SoakNetwork");
+  preferences.putString("password", "soak-password");
+  preferences.putString("probe_targets", "127.0.0.1:1/generate_204"); // Refused at once
+  setup();
+
+  uint32_t start = millis();
+  while (server.serve(HTTP_GET, "/status") != 200 || metrics.bootFirstProbeUs == 0)
+  {
+    if (millis() - start > BOOT_TIMEOUT_MS)
+      return false;
+    loop();
+  }
+  return true;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+  Serial.mute(false);
+}
+
+void test_handlers_apply_and_reject()
+{
+  runRound();
+  TEST_ASSERT_EQUAL(200, server.serve(HTTP_GET, "/status"));
+  TEST_ASSERT_NOT_NULL(strstr(server.responseBody(), "\"wifi_connected\":true"));
+  TEST_ASSERT_NOT_NULL(strstr(server.responseBody(), "\"effect\":\"static\""));
+  TEST_ASSERT_NOT_NULL(strstr(server.responseBody(), "\"brightness\":80,\"speed\":150"));
+}
+
+void test_counter_sees_a_leak()
+{
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 33)
+  TEST_IGNORE_MESSAGE("Heap counting needs glibc 2.33 or later");
+#else
+  uint32_t before = ESP.getFreeHeap();
+  char *volatile leak = (char *)malloc(64);
+  TEST_ASSERT_LESS_OR_EQUAL(before - 64, ESP.getFreeHeap());
+  free(leak);
+  TEST_ASSERT_EQUAL(before, ESP.getFreeHeap());
+#endif
+}
+
+void test_heap_stays_flat_across_rounds()
+{
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 33)
+  TEST_IGNORE_MESSAGE("Heap counting needs glibc 2.33 or later");
+#else
+  Serial.mute(true); // Effect changes and page timings are logged on every round
+  for (int i = 0; i < WARMUP_ROUNDS; i++)
+    runRound();
+
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largestBlock = ESP.getMaxAllocHeap();
+  for (int i = 0; i < SOAK_ROUNDS; i++)
+  {
+    runRound();
+    TEST_ASSERT_EQUAL_MESSAGE(freeHeap, ESP.getFreeHeap(), "live bytes changed");
+    TEST_ASSERT_EQUAL_MESSAGE(largestBlock, ESP.getMaxAllocHeap(), "largest block changed");
+  }
+#endif
+}
+
+int main(int argc, char **argv)
+{
+  if (!boot())
+  {
+    printf("Monitoring mode did not start within %d ms\n", BOOT_TIMEOUT_MS);
+    return 1;
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(test_handlers_apply_and_reject);
+  RUN_TEST(test_counter_sees_a_leak);
+  RUN_TEST(test_heap_stays_flat_across_rounds);
+  return UNITY_END();
+}
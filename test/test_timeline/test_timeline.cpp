@@ -0,0 +1,174 @@
+// Timeline uploads and their handoff to the render task. Runs on the host
+// against an in-memory LittleFS: pio test -e native
+
+#include <unity.h>
+#include <vector>
+#include "effects.h"
+#include "timeline.h"
+
+#define STRIP_LENGTH 100
+
+static CRGB leds[STRIP_LENGTH];
+static const EffectSettings settings = {CRGB::Green, CRGB::Red};
+
+static void putU16(std::vector<uint8_t> &data, uint16_t value)
+{
+  data.push_back(value & 0xFF);
+  data.push_back(value >> 8);
+}
+
+static std::vector<uint8_t> header(uint8_t count, uint16_t durationMs)
+{
+  std::vector<uint8_t> data = {'W', 'M', 'T', 'L', TIMELINE_VERSION, count};
+  putU16(data, durationMs);
+  return data;
+}
+
+static void addStep(std::vector<uint8_t> &data, TimelineOp op, uint16_t startMs, uint16_t endMs, uint16_t from,
+                    uint16_t to, uint16_t param, const CRGB &colorA, const CRGB &colorB)
+{
+  data.push_back(op);
+  data.push_back(EASE_LINEAR);
+  putU16(data, startMs);
+  putU16(data, endMs);
+  putU16(data, from);
+  putU16(data, to);
+  putU16(data, param);
+  data.insert(data.end(), {colorA.r, colorA.g, colorA.b, colorB.r, colorB.g, colorB.b});
+}
+
+// Whole strip in one color for the whole loop
+static std::vector<uint8_t> solidTimeline(const CRGB &color)
+{
+  std::vector<uint8_t> data = header(1, 1000);
+  addStep(data, TIMELINE_FILL, 0, 1000, 0, 65535, 0, color, color);
+  return data;
+}
+
+// In chunks, the way the web server hands a multipart upload over
+static TimelineStatus upload(const std::vector<uint8_t> &data)
+{
+  beginTimelineUpload();
+  for (size_t offset = 0; offset < data.size(); offset += 64)
+    writeTimelineUpload(data.data() + offset, min<size_t>(64, data.size() - offset));
+  return commitTimelineUpload();
+}
+
+// One pass of the render task showing some other effect
+static void renderPass()
+{
+  acceptTimeline();
+  EffectState state = {};
+  EffectFrame frame = {leds, STRIP_LENGTH, millis(), 20, &state};
+  renderEffect(EFFECT_RAINBOW, frame, settings);
+}
+
+static void renderTimelineAt(uint32_t now)
+{
+  acceptTimeline();
+  EffectState state = {};
+  EffectFrame frame = {leds, STRIP_LENGTH, now, 20, &state};
+  renderEffect(EFFECT_TIMELINE, frame, settings);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_boot_loads_the_built_in_timeline()
+{
+  beginTimeline();
+  TEST_ASSERT_FALSE(timelineFromFlash());
+  TEST_ASSERT_EQUAL_UINT8(5, timelineStepCount());
+  TEST_ASSERT_EQUAL_UINT16(4000, timelineDuration());
+}
+
+void test_upload_is_accepted_while_another_effect_is_shown()
+{
+  // The timeline effect was never shown since boot
+  renderPass();
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(solidTimeline(CRGB::Blue)));
+  TEST_ASSERT_TRUE(timelineFromFlash());
+  TEST_ASSERT_EQUAL_UINT8(1, timelineStepCount());
+
+  renderPass();
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(solidTimeline(CRGB::Red)));
+}
+
+void test_back_to_back_uploads_wait_for_a_render_pass()
+{
+  renderPass();
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(solidTimeline(CRGB::Blue)));
+  TEST_ASSERT_EQUAL(TIMELINE_BUSY, upload(solidTimeline(CRGB::Red)));
+  renderPass();
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(solidTimeline(CRGB::Red)));
+}
+
+void test_uploaded_timeline_is_drawn()
+{
+  renderPass();
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(solidTimeline(CRGB::Blue)));
+  renderTimelineAt(500);
+  for (int i = 0; i < STRIP_LENGTH; i++)
+    TEST_ASSERT_TRUE(leds[i] == CRGB(CRGB::Blue));
+
+  // A gradient runs from color A at `from` to B at `to`
+  std::vector<uint8_t> data = header(1, 1000);
+  addStep(data, TIMELINE_GRADIENT, 0, 1000, 0, 65535, 0, CRGB(0, 0, 0), CRGB(255, 0, 0));
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(data));
+  renderTimelineAt(500);
+  TEST_ASSERT_EQUAL_UINT8(0, leds[0].r);
+  TEST_ASSERT_GREATER_THAN(240, leds[STRIP_LENGTH - 1].r);
+  for (int i = 1; i < STRIP_LENGTH; i++)
+    TEST_ASSERT_GREATER_OR_EQUAL(leds[i - 1].r, leds[i].r);
+}
+
+void test_bad_uploads_are_rejected_and_keep_the_loaded_timeline()
+{
+  renderPass();
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(solidTimeline(CRGB::Blue)));
+  renderPass();
+
+  std::vector<uint8_t> wrongMagic = solidTimeline(CRGB::Red);
+  wrongMagic[0] = 'X';
+  TEST_ASSERT_EQUAL(TIMELINE_INVALID, upload(wrongMagic));
+
+  std::vector<uint8_t> endsLate = header(1, 1000);
+  addStep(endsLate, TIMELINE_FILL, 0, 1001, 0, 65535, 0, CRGB::Red, CRGB::Red);
+  TEST_ASSERT_EQUAL(TIMELINE_INVALID, upload(endsLate));
+
+  std::vector<uint8_t> tooLarge(TIMELINE_MAX_SIZE + 1, 0);
+  TEST_ASSERT_EQUAL(TIMELINE_TOO_LARGE, upload(tooLarge));
+
+  renderTimelineAt(500);
+  TEST_ASSERT_TRUE(leds[0] == CRGB(CRGB::Blue));
+}
+
+void test_stored_timeline_is_loaded_at_boot()
+{
+  renderPass();
+  TEST_ASSERT_EQUAL(TIMELINE_OK, upload(solidTimeline(CRGB::Green)));
+  renderPass();
+
+  beginTimeline(); // A reboot, the file is still there
+  TEST_ASSERT_TRUE(timelineFromFlash());
+  TEST_ASSERT_EQUAL_UINT8(1, timelineStepCount());
+  renderTimelineAt(0);
+  TEST_ASSERT_TRUE(leds[0] == CRGB(CRGB::Green));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_boot_loads_the_built_in_timeline);
+  RUN_TEST(test_upload_is_accepted_while_another_effect_is_shown);
+  RUN_TEST(test_back_to_back_uploads_wait_for_a_render_pass);
+  RUN_TEST(test_uploaded_timeline_is_drawn);
+  RUN_TEST(test_bad_uploads_are_rejected_and_keep_the_loaded_timeline);
+  RUN_TEST(test_stored_timeline_is_loaded_at_boot);
+  return UNITY_END();
+}
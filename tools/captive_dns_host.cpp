@@ -0,0 +1,66 @@
+// Runs the captive portal DNS engine on Linux, so tools/dns_load.py can be
+// pointed at it without a device.
+//
+//   g++ -O2 -Isrc tools/captive_dns_host.cpp src/captive_dns.cpp -o captive_dns_host
+//   ./captive_dns_host [port] [queries per second per client, 0 = unlimited]
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "captive_dns.h"
+
+static uint32_t millis()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+int main(int argc, char **argv)
+{
+  int port = argc > 1 ? atoi(argv[1]) : 5353;
+  uint16_t rateLimit = argc > 2 ? atoi(argv[2]) : DNS_RATE_LIMIT;
+
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (sock < 0 || bind(sock, (sockaddr *)&address, sizeof(address)) != 0)
+  {
+    perror("bind");
+    return 1;
+  }
+
+  const uint8_t portal[4] = {192, 168, 4, 1};
+  beginCaptiveDns(portal, rateLimit);
+  printf("Answering on 127.0.0.1:%d, rate limit %u/s per client\n", port, rateLimit);
+
+  uint8_t query[DNS_MAX_PACKET];
+  uint8_t response[DNS_MAX_PACKET];
+  uint32_t lastReport = millis();
+  for (;;)
+  {
+    sockaddr_in client;
+    socklen_t clientLength = sizeof(client);
+    ssize_t length = recvfrom(sock, query, sizeof(query), 0, (sockaddr *)&client, &clientLength);
+    if (length < 0)
+      continue;
+
+    size_t reply = answerCaptiveDns(client.sin_addr.s_addr, millis(), query, length, response);
+    if (reply != 0)
+      sendto(sock, response, reply, 0, (sockaddr *)&client, clientLength);
+
+    if (millis() - lastReport >= 5000)
+    {
+      const CaptiveDnsStats &stats = captiveDnsStats();
+      printf("queries %u, answered %u, cache hits %u, rate limited %u, malformed %u\n", stats.queries,
+             stats.answered, stats.cacheHits, stats.rateLimited, stats.malformed);
+      lastReport = millis();
+    }
+  }
+}
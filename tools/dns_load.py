@@ -0,0 +1,112 @@
+"""Flood a captive portal DNS server with queries and report throughput and latency.
+
+Usage: python tools/dns_load.py <host> [--port N] [--rate QPS] [--seconds N] [--clients N]
+
+Sends A and AAAA queries for the connectivity check names phones use, at
+a fixed rate, from several sockets at once. Against a device, connect to its
+access point and use 192.168.4.1. Against tools/captive_dns_host.cpp, use
+127.0.0.1 --port 5353. All sockets share one source address, so the
+per-client rate limit applies to the total unless it is turned off on the
+host build. Unanswered queries count as lost after one second.
+"""
+
+import argparse
+import random
+import selectors
+import socket
+import struct
+import time
+
+NAMES = [
+    "connectivitycheck.gstatic.com",
+    "clients3.google.com",
+    "captive.apple.com",
+    "www.msftconnecttest.com",
+    "detectportal.firefox.com",
+]
+TIMEOUT = 1.0
+
+
+def build_query(query_id, name, qtype):
+    header = struct.pack(">HHHHHH", query_id, 0x0100, 1, 0, 0, 0)
+    labels = b"".join(bytes([len(part)]) + part.encode() for part in name.split("."))
+    return header + labels + b"\0" + struct.pack(">HH", qtype, 1)
+
+
+def percentile(values, fraction):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=53)
+    parser.add_argument("--rate", type=float, default=200, help="queries per second")
+    parser.add_argument("--seconds", type=float, default=10)
+    parser.add_argument("--clients", type=int, default=4, help="sockets, i.e. source ports")
+    args = parser.parse_args()
+
+    selector = selectors.DefaultSelector()
+    sockets = []
+    for _ in range(args.clients):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setblocking(False)
+        sock.connect((args.host, args.port))
+        selector.register(sock, selectors.EVENT_READ)
+        sockets.append(sock)
+
+    pending = {}  # (socket index, id) -> send time
+    latencies = []
+    sent = 0
+    malformed = 0
+    start = time.monotonic()
+    end = start + args.seconds
+    next_send = start
+
+    while True:
+        now = time.monotonic()
+        if now >= end and not pending:
+            break
+        while now < end and next_send <= now:
+            index = sent % len(sockets)
+            query_id = random.getrandbits(16)
+            qtype = 28 if sent % 4 == 3 else 1  # Some AAAA, like real phones
+            try:
+                sockets[index].send(build_query(query_id, random.choice(NAMES), qtype))
+                pending[(index, query_id)] = now
+            except OSError:
+                pass  # Counted as lost
+            sent += 1
+            next_send += 1 / args.rate
+
+        timeout = max(0, min(next_send if now < end else now + 0.01, now + 0.01) - now)
+        for key, _ in selector.select(timeout):
+            index = sockets.index(key.fileobj)
+            try:
+                reply = key.fileobj.recv(512)
+            except OSError:
+                continue
+            if len(reply) < 12 or not reply[2] & 0x80:
+                malformed += 1
+                continue
+            sent_at = pending.pop((index, struct.unpack(">H", reply[:2])[0]), None)
+            if sent_at is not None:
+                latencies.append(time.monotonic() - sent_at)
+
+        now = time.monotonic()
+        for key in [key for key, sent_at in pending.items() if now - sent_at > TIMEOUT]:
+            del pending[key]
+
+    elapsed = args.seconds
+    lost = sent - len(latencies)
+    print(f"sent {sent} queries in {elapsed:.1f} s, {len(latencies)} answered, {lost} lost, {malformed} malformed")
+    print(f"throughput {len(latencies) / elapsed:.0f} answers/s")
+    print(f"latency p50 {percentile(latencies, 0.5) * 1000:.2f} ms, "
+          f"p99 {percentile(latencies, 0.99) * 1000:.2f} ms, max {max(latencies, default=0) * 1000:.2f} ms")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,158 @@
+// Runs the effect benchmark on the host, against the Arduino/FastLED shim
+// of the native test env. Prints the same table as the serial "bench"
+// command; the shim's cycle counter counts nanoseconds. Further tables
+// compare the lookup-table effects with the per-pixel HSV conversion they
+// replaced, and time the heaviest timeline the format allows.
+//
+//   g++ -O2 -pthread -Isrc -Itest/lib/native_shim/src tools/effect_bench_host.cpp src/benchmark.cpp src/effects.cpp src/timeline.cpp test/lib/native_shim/src/*.cpp -o effect_bench_host
+//   ./effect_bench_host
+
+#include <chrono>
+#include <vector>
+#include "benchmark.h"
+#include "effects.h"
+#include "timeline.h"
+
+static const int sizes[] = {300, 1000, 5000};
+static const EffectSettings settings = {CRGB(0x00, 0xFF, 0x00), CRGB(0xFF, 0x00, 0x00)};
+
+static uint8_t phase(uint32_t now, EffectId id)
+{
+  return (uint64_t)now * effectRegistry[id].params.step / EFFECT_STEP_MS;
+}
+
+// The effects as they were before the lookup tables
+static void rainbowHsv(const EffectFrame &frame)
+{
+  uint8_t hue = phase(frame.now, EFFECT_RAINBOW);
+  for (int i = 0; i < frame.count; i++)
+    frame.leds[i] = CHSV((hue + i * 255 / frame.count) % 255, 255, 255);
+}
+
+static void fillRainbowHsv(const EffectFrame &frame)
+{
+  fill_rainbow(frame.leds, frame.count, phase(frame.now, EFFECT_FILL_RAINBOW), 7);
+}
+
+static void waitingHsv(const EffectFrame &frame)
+{
+  uint8_t hue = phase(frame.now, EFFECT_WAITING);
+  uint8_t beat = (uint64_t)frame.now * 20 * 256 / 60000;
+  for (int i = 0; i < frame.count; i++)
+  {
+    uint8_t brightness = 100 + scale8(sin8(beat + i * 10), 155);
+    frame.leds[i] = CHSV((hue + i * 20) % 255, 200, brightness);
+  }
+}
+
+struct Reference
+{
+  EffectId effect;
+  void (*render)(const EffectFrame &frame);
+};
+
+static const Reference references[] = {
+    {EFFECT_RAINBOW, rainbowHsv},
+    {EFFECT_FILL_RAINBOW, fillRainbowHsv},
+    {EFFECT_WAITING, waitingHsv},
+};
+
+// Mean time of one frame, after one warm-up frame
+template <typename Render>
+static double nsPerFrame(CRGB *leds, int count, Render render)
+{
+  EffectState state = {};
+  EffectFrame frame = {leds, count, 0, 50, &state};
+  render(frame);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCHMARK_FRAMES; i++)
+  {
+    frame.now += frame.elapsed;
+    render(frame);
+  }
+  std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+  return spent.count() / BENCHMARK_FRAMES;
+}
+
+static void compareWithHsv()
+{
+  Serial.println("\nLookup tables against per-pixel HSV, ns/frame");
+  Serial.println("effect          leds        hsv      table  speedup");
+  for (int size : sizes)
+  {
+    CRGB *leds = new CRGB[size];
+    for (const Reference &reference : references)
+    {
+      double hsv = nsPerFrame(leds, size, reference.render);
+      double table = nsPerFrame(leds, size, [&](const EffectFrame &frame)
+                                { renderEffect(reference.effect, frame, settings); });
+      Serial.printf("%-14s %5d %10.0f %10.0f %7.1fx\n", effectRegistry[reference.effect].name, size, hsv, table,
+                    hsv / table);
+    }
+    delete[] leds;
+  }
+}
+
+static void putU16(std::vector<uint8_t> &data, uint16_t value)
+{
+  data.push_back(value & 0xFF);
+  data.push_back(value >> 8);
+}
+
+// MAX_TIMELINE_STEPS steps, all running the whole loop over the whole strip
+static std::vector<uint8_t> worstCaseTimeline()
+{
+  const uint8_t ops[] = {TIMELINE_GRADIENT, TIMELINE_FILL, TIMELINE_SEGMENT, TIMELINE_FADE};
+  std::vector<uint8_t> data = {'W', 'M', 'T', 'L', TIMELINE_VERSION, MAX_TIMELINE_STEPS};
+  putU16(data, 4000);
+  for (uint8_t i = 0; i < MAX_TIMELINE_STEPS; i++)
+  {
+    data.push_back(ops[i % 4]);
+    data.push_back(EASE_IN_OUT);
+    putU16(data, 0);
+    putU16(data, 4000);
+    putU16(data, 0);
+    putU16(data, 65535);
+    putU16(data, ops[i % 4] == TIMELINE_FADE ? 0xFF40 : 32768); // Fade levels, or half-strip segment
+    data.insert(data.end(), {0x00, 0x20, 0xFF, 0x80, 0x00, 0xFF});
+  }
+  return data;
+}
+
+static void benchmarkWorstCaseTimeline()
+{
+  std::vector<uint8_t> data = worstCaseTimeline();
+  beginTimelineUpload();
+  writeTimelineUpload(data.data(), data.size());
+  TimelineStatus status = commitTimelineUpload();
+  if (status != TIMELINE_OK)
+  {
+    Serial.printf("Worst-case timeline rejected: %s\n", timelineStatusMessage(status));
+    return;
+  }
+  acceptTimeline();
+
+  Serial.printf("\nWorst-case timeline, %d full-strip steps\n", MAX_TIMELINE_STEPS);
+  Serial.println("leds     ns/frame  of a 20 FPS frame");
+  for (int size : sizes)
+  {
+    CRGB *leds = new CRGB[size];
+    double ns = nsPerFrame(leds, size, [](const EffectFrame &frame)
+                           { renderEffect(EFFECT_TIMELINE, frame, settings); });
+    Serial.printf("%5d %12.0f %17.3f%%\n", size, ns, ns / 50e6 * 100);
+    delete[] leds;
+  }
+}
+
+int main()
+{
+  // The shim's file system starts empty, so this loads the built-in timeline
+  beginTimeline();
+  acceptTimeline();
+
+  runEffectBenchmark(Serial);
+  compareWithHsv();
+  benchmarkWorstCaseTimeline();
+  return 0;
+}
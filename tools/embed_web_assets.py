@@ -0,0 +1,85 @@
+"""Gzip the files in web/ and embed them as PROGMEM arrays in src/web_assets.h.
+
+Runs as a PlatformIO pre-build script (extra_scripts = pre:tools/embed_web_assets.py)
+and can also be run by hand from the project root.
+"""
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "web")
+OUTPUT = os.path.join(PROJECT_DIR, "src", "web_assets.h")
+
+CONTENT_TYPES = {
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".html": "text/html",
+    ".svg": "image/svg+xml",
+}
+
+
+def symbol_for(name):
+    return name.upper().replace(".", "_").replace("-", "_") + "_GZ"
+
+
+def build():
+    names = sorted(n for n in os.listdir(WEB_DIR) if os.path.splitext(n)[1] in CONTENT_TYPES)
+
+    lines = [
+        "// Generated by tools/embed_web_assets.py from web/, do not edit",
+        "#pragma once",
+        "",
+        "#include <Arduino.h>",
+        "",
+        "struct WebAsset",
+        "{",
+        "  const char *path;",
+        "  const char *contentType;",
+        "  const uint8_t *data; // gzip compressed",
+        "  size_t length;",
+        "  const char *etag;",
+        "};",
+        "",
+    ]
+    entries = []
+    for name in names:
+        with open(os.path.join(WEB_DIR, name), "rb") as f:
+            raw = f.read()
+        # mtime=0 keeps the output (and the ETag) stable between builds
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = hashlib.sha1(raw).hexdigest()[:16]
+        symbol = symbol_for(name)
+
+        lines.append("// %s: %d bytes, %d gzipped" % (name, len(raw), len(packed)))
+        lines.append("static const uint8_t %s[] PROGMEM = {" % symbol)
+        for i in range(0, len(packed), 16):
+            lines.append("    " + ", ".join("0x%02x" % b for b in packed[i:i + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+        entries.append('    {"/%s", "%s", %s, sizeof(%s), "\\"%s\\""},'
+                       % (name, CONTENT_TYPES[os.path.splitext(name)[1]], symbol, symbol, etag))
+
+    lines.append("static const WebAsset webAssets[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append("static const size_t webAssetCount = sizeof(webAssets) / sizeof(webAssets[0]);")
+    content = "\n".join(lines) + "\n"
+
+    # Only touch the header when something changed to avoid needless rebuilds
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            if f.read() == content:
+                return
+    with open(OUTPUT, "w") as f:
+        f.write(content)
+    print("embed_web_assets: wrote %s (%d assets)" % (OUTPUT, len(names)))
+
+
+build()
@@ -0,0 +1,97 @@
+"""Compile a JSON timeline description into the binary format POST /timeline accepts.
+
+Usage: python tools/make_timeline.py show.json show.bin
+       curl -F file=@show.bin http://<device>/timeline
+
+The JSON holds the loop length and a list of steps drawn in order:
+
+    {"duration_ms": 4000, "steps": [
+        {"op": "gradient", "start_ms": 0, "end_ms": 4000, "from": 0.0, "to": 1.0,
+         "color_a": "#0020FF", "color_b": "#8000FF"},
+        {"op": "segment", "easing": "in_out", "start_ms": 0, "end_ms": 2000,
+         "from": 0.0, "to": 0.9, "width": 0.1, "color_a": "#FFFFFF"},
+        {"op": "fade", "start_ms": 0, "end_ms": 2000, "level_from": 255, "level_to": 120}
+    ]}
+
+Positions (from, to, width) are fractions of the whole strip. See src/timeline.h
+for the binary layout.
+"""
+
+import json
+import struct
+import sys
+
+VERSION = 1
+MAX_STEPS = 32  # MAX_TIMELINE_STEPS
+OPS = {"fill": 0, "gradient": 1, "segment": 2, "fade": 3}
+EASINGS = {"linear": 0, "in": 1, "out": 2, "in_out": 3}
+
+
+def position(value):
+    if not 0.0 <= value <= 1.0:
+        raise ValueError(f"position {value} outside 0..1")
+    return round(value * 65535)
+
+
+def color(text):
+    text = text.lstrip("#")
+    if len(text) != 6:
+        raise ValueError(f"bad color {text!r}, expected #RRGGBB")
+    return bytes.fromhex(text)
+
+
+def encode_step(step, duration):
+    op = OPS[step["op"]]
+    start, end = step["start_ms"], step["end_ms"]
+    if not 0 <= start < end <= duration:
+        raise ValueError(f"step window {start}..{end} outside 0..{duration}")
+
+    if op == OPS["segment"]:
+        param = position(step["width"])
+    elif op == OPS["fade"]:
+        param = (step["level_from"] << 8) | step["level_to"]
+    else:
+        param = 0
+
+    return struct.pack(
+        "<BBHHHHH3s3s",
+        op,
+        EASINGS[step.get("easing", "linear")],
+        start,
+        end,
+        position(step.get("from", 0.0)),
+        position(step.get("to", 1.0)),
+        param,
+        color(step.get("color_a", "#000000")),
+        color(step.get("color_b", step.get("color_a", "#000000"))),
+    )
+
+
+def compile_timeline(description):
+    duration = description["duration_ms"]
+    steps = description["steps"]
+    if not 0 < duration <= 0xFFFF:
+        raise ValueError("duration_ms must be 1..65535")
+    if not 0 < len(steps) <= MAX_STEPS:
+        raise ValueError(f"need 1..{MAX_STEPS} steps")
+
+    data = b"WMTL" + struct.pack("<BBH", VERSION, len(steps), duration)
+    for step in steps:
+        data += encode_step(step, duration)
+    return data
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        return 2
+    with open(sys.argv[1]) as f:
+        data = compile_timeline(json.load(f))
+    with open(sys.argv[2], "wb") as f:
+        f.write(data)
+    print(f"{sys.argv[2]}: {len(data)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,102 @@
+"""Measure page response times and the heap they cost on a device.
+
+Usage: python tools/page_bench.py <device-ip> [--requests N] [--save FILE] [--compare FILE]
+
+Fetches each page the given number of times and reports p50/p99/max response
+time as seen by the client. Firmware with /metrics also reports the lowest
+free heap and the largest free block before and after the run. Use --save on
+one firmware and --compare on the other to get the before/after table, e.g.
+the commit before the streaming pages against the current tree. Firmware
+without /metrics only gets response times compared.
+"""
+
+import argparse
+import json
+import sys
+import time
+import urllib.error
+import urllib.request
+
+PATHS = ["/", "/style.css", "/effects.js"]
+
+
+def fetch(url):
+    start = time.perf_counter()
+    try:
+        with urllib.request.urlopen(url, timeout=10) as response:
+            size = len(response.read())
+    except urllib.error.HTTPError as error:
+        size = len(error.read())
+    return time.perf_counter() - start, size
+
+
+def heap(base):
+    try:
+        with urllib.request.urlopen(base + "/metrics", timeout=10) as response:
+            text = response.read().decode(errors="replace")
+    except (urllib.error.URLError, OSError):
+        return None
+    values = {}
+    for line in text.splitlines():
+        if line.startswith("wifimon_heap_"):
+            name, value = line.split()
+            values[name] = int(float(value))
+    return values or None
+
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--requests", type=int, default=100)
+    parser.add_argument("--save", help="write the results as JSON")
+    parser.add_argument("--compare", help="JSON from an earlier run to compare against")
+    args = parser.parse_args()
+    base = "http://" + args.host
+
+    results = {"heap_before": heap(base), "pages": {}}
+    for path in PATHS:
+        times = []
+        size = 0
+        for _ in range(args.requests):
+            elapsed, size = fetch(base + path)
+            times.append(elapsed * 1000)
+        results["pages"][path] = {
+            "bytes": size,
+            "p50_ms": percentile(times, 0.5),
+            "p99_ms": percentile(times, 0.99),
+            "max_ms": max(times),
+        }
+    results["heap_after"] = heap(base)
+
+    earlier = None
+    if args.compare:
+        with open(args.compare) as file:
+            earlier = json.load(file)
+
+    print(f"{'page':<12} {'bytes':>7} {'p50 ms':>8} {'p99 ms':>8} {'max ms':>8}")
+    for path, page in results["pages"].items():
+        print(f"{path:<12} {page['bytes']:7} {page['p50_ms']:8.1f} {page['p99_ms']:8.1f} {page['max_ms']:8.1f}")
+        old = earlier["pages"].get(path) if earlier else None
+        if old:
+            print(f"{'  before':<12} {old['bytes']:7} {old['p50_ms']:8.1f} {old['p99_ms']:8.1f} {old['max_ms']:8.1f}")
+
+    for label, run in (("now", results), ("before", earlier)):
+        if run and run["heap_before"] and run["heap_after"]:
+            first, last = run["heap_before"], run["heap_after"]
+            print(f"heap {label}: min free {first['wifimon_heap_min_free_bytes']} -> "
+                  f"{last['wifimon_heap_min_free_bytes']}, largest block "
+                  f"{first['wifimon_heap_largest_block_bytes']} -> {last['wifimon_heap_largest_block_bytes']}")
+
+    if args.save:
+        with open(args.save, "w") as file:
+            json.dump(results, file, indent=2)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
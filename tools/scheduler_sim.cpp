@@ -0,0 +1,287 @@
+// Host simulation of the loop() scheduler with a fake clock. Compares HTTP
+// and DNS latency and loop wakeups of the old poll-everything-then-delay(10)
+// loop with src/scheduler.cpp under the same arrivals. As in main.cpp, the
+// http and dns tasks only run when the socket watcher signals them.
+//
+//   g++ -O2 -Isrc tools/scheduler_sim.cpp src/scheduler.cpp -o scheduler_sim
+//   ./scheduler_sim [seconds] [requests per second, 0 = idle] [monitoring|factory]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "captive_dns.h"
+#include "scheduler.h"
+
+#define MAX_QUEUED 64
+#define HTTP_POLL_US 2000 // HTTP_POLL_INTERVAL, while the server holds a client
+
+static uint32_t now = 0; // Fake clock in microseconds
+static uint32_t seed = 1;
+
+// Requests or queries arriving on one socket
+struct Source
+{
+  uint32_t arrivals[MAX_QUEUED];
+  int queued;
+  uint32_t nextArrival;
+  uint32_t meanGapUs; // 0 if nothing arrives
+  bool armed;         // Watched by the socket watcher
+  int task;
+
+  // Latency of served requests
+  uint64_t latencySum;
+  uint32_t latencyMax;
+  uint32_t served;
+};
+
+static Source httpSource;
+static Source dnsSource;
+static bool httpHeld = false; // WebServer waits for the client to close
+static uint32_t watcherWakeups = 0;
+
+static uint32_t fakeClock()
+{
+  return now;
+}
+
+static uint32_t randomGap(const Source &source)
+{
+  seed = seed * 1103515245 + 12345;
+  return source.meanGapUs / 2 + (seed >> 8) % source.meanGapUs; // Uniform around the mean
+}
+
+// Queues what arrived up to the current time
+static void deliver(Source &source)
+{
+  while (source.meanGapUs != 0 && (int32_t)(now - source.nextArrival) >= 0)
+  {
+    if (source.queued < MAX_QUEUED)
+      source.arrivals[source.queued++] = source.nextArrival;
+    source.nextArrival += randomGap(source);
+  }
+}
+
+static void serveOne(Source &source)
+{
+  uint32_t latency = now - source.arrivals[0];
+  source.latencySum += latency;
+  if (latency > source.latencyMax)
+    source.latencyMax = latency;
+  source.served++;
+  for (int i = 1; i < source.queued; i++)
+    source.arrivals[i - 1] = source.arrivals[i];
+  source.queued--;
+}
+
+// Costs are rough device numbers for the idle case
+static void httpPoll()
+{
+  now += 30;
+  deliver(httpSource);
+  if (httpSource.queued == 0)
+    return;
+
+  // WebServer handles one client per call
+  serveOne(httpSource);
+  now += 2000; // Handler time
+}
+
+static void dnsPoll()
+{
+  now += 20;
+  deliver(dnsSource);
+  if (dnsSource.queued == 0)
+    return;
+  serveOne(dnsSource); // DNSServer answers one query per call
+  now += 100;
+}
+
+// handleHttpClient(): polled while a client is held, then back to the watcher
+static void http()
+{
+  if (httpHeld)
+  {
+    now += 30;
+    httpHeld = false;
+  }
+  else
+  {
+    uint32_t served = httpSource.served;
+    httpPoll();
+    httpHeld = httpSource.served != served;
+  }
+  setSchedulerTaskPeriod(httpSource.task, httpHeld ? HTTP_POLL_US : 0);
+  if (!httpHeld)
+    httpSource.armed = true;
+}
+
+// processDnsRequests(): drains the socket, then back to the watcher
+static void dns()
+{
+  now += 20;
+  deliver(dnsSource);
+  for (int i = 0; i < DNS_MAX_PACKETS_PER_TICK && dnsSource.queued > 0; i++)
+  {
+    serveOne(dnsSource);
+    now += 100;
+  }
+  dnsSource.armed = true;
+}
+
+static void provisioning() { now += 5; }
+static void resetButton() { now += 5; }
+static void serial() { now += 5; }
+static void settings() { now += 5; }
+static void internet() { now += 20; }
+static void eventClients() { now += 30; }
+static void liveStatus() { now += 200; }
+static void wifiScan() { now += 5; }
+
+static void resetSource(Source &source, uint32_t perSecond)
+{
+  source.queued = 0;
+  source.meanGapUs = perSecond ? 1000000 / perSecond : 0;
+  source.nextArrival = perSecond ? randomGap(source) : 0;
+  source.armed = true;
+  source.task = -1;
+  source.latencySum = 0;
+  source.latencyMax = 0;
+  source.served = 0;
+}
+
+static void resetRun(uint32_t httpPerSecond, uint32_t dnsPerSecond)
+{
+  now = 0;
+  seed = 1;
+  resetSource(httpSource, httpPerSecond);
+  resetSource(dnsSource, dnsPerSecond);
+  httpHeld = false;
+  watcherWakeups = 0;
+}
+
+// When the watcher would see the source readable, or never (UINT32_MAX)
+static uint32_t readableAt(const Source &source)
+{
+  if (source.task < 0 || !source.armed)
+    return UINT32_MAX;
+  if (source.queued > 0)
+    return now;
+  return source.meanGapUs ? source.nextArrival : UINT32_MAX;
+}
+
+static void report(const char *name, const Source &source)
+{
+  printf("  %-5s %6u served, latency mean %6.2f ms, max %6.2f ms\n", name, source.served,
+         source.served ? source.latencySum / 1000.0 / source.served : 0.0, source.latencyMax / 1000.0);
+}
+
+static void reportRun(const char *name, uint32_t wakeups, uint32_t seconds, bool factory)
+{
+  printf("%-22s %5u loop wakeups/s, %4u socket watcher wakeups/s\n", name, wakeups / seconds,
+         watcherWakeups / seconds);
+  report("http", httpSource);
+  if (factory)
+    report("dns", dnsSource);
+}
+
+// Old loop(): every subsystem on every pass, then delay(10)
+static void runDelayLoop(uint32_t seconds, uint32_t rate, bool factory)
+{
+  uint32_t endUs = seconds * 1000000;
+  uint32_t wakeups = 0;
+  resetRun(rate, factory ? rate * 4 : 0);
+  while (now < endUs)
+  {
+    httpPoll();
+    if (factory)
+      dnsPoll();
+    provisioning();
+    resetButton();
+    serial();
+    if (!factory)
+    {
+      internet();
+      eventClients();
+      liveStatus();
+    }
+    now += 10000;
+    wakeups++;
+  }
+  reportRun(factory ? "factory delay(10)" : "monitoring delay(10)", wakeups, seconds, factory);
+}
+
+// Scheduler with the periods main.cpp registers in each mode
+static void runScheduled(uint32_t seconds, uint32_t rate, bool factory)
+{
+  uint32_t endUs = seconds * 1000000;
+  uint32_t wakeups = 0;
+  resetRun(rate, factory ? rate * 4 : 0);
+  setSchedulerClock(fakeClock);
+  httpSource.task = addSchedulerTask("http", http, 0, 50000);
+  addSchedulerTask("provisioning", provisioning, 100000, 5000);
+  addSchedulerTask("reset_button", resetButton, 50000, 1000);
+  addSchedulerTask("serial", serial, 50000, 1000);
+  addSchedulerTask("settings", settings, 250000, 50000);
+  if (factory)
+  {
+    dnsSource.task = addSchedulerTask("dns", dns, 0, 2000);
+    addSchedulerTask("wifi_scan", wifiScan, 100000, 5000);
+  }
+  else
+  {
+    addSchedulerTask("internet", internet, 100000, 5000);
+    addSchedulerTask("event_clients", eventClients, 100000, 5000);
+    addSchedulerTask("live_status", liveStatus, 500000, 20000);
+  }
+
+  while (now < endUs)
+  {
+    uint32_t wait = runScheduler();
+    uint32_t deadline = now + (wait + 999) / 1000 * 1000; // Sleeps are whole RTOS ticks
+
+    // The socket watcher wakes loop() early when a watched socket turns readable
+    Source *sources[] = {&httpSource, &dnsSource};
+    Source *ready = NULL;
+    uint32_t readyAt = deadline;
+    for (Source *source : sources)
+    {
+      uint32_t at = readableAt(*source);
+      if (at != UINT32_MAX && (int32_t)(at - readyAt) < 0)
+      {
+        ready = source;
+        readyAt = at;
+      }
+    }
+    if (ready != NULL)
+    {
+      now = (int32_t)(readyAt - now) > 0 ? readyAt : now;
+      ready->armed = false;
+      signalSchedulerTask(ready->task);
+      watcherWakeups++;
+    }
+    else
+    {
+      now = deadline;
+    }
+    wakeups++;
+  }
+  reportRun(factory ? "factory scheduler" : "monitoring scheduler", wakeups, seconds, factory);
+
+  for (uint8_t i = 0; i < schedulerTaskCount(); i++)
+  {
+    const SchedulerTask &task = schedulerTaskAt(i);
+    printf("    %-14s %7u runs, max %5u us, late max %5u us, %u overruns\n", task.name, task.runs, task.maxRunUs,
+           task.maxLateUs, task.overruns);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t seconds = argc > 1 ? atoi(argv[1]) : 60;
+  uint32_t rate = argc > 2 ? atoi(argv[2]) : 5;
+  bool factory = argc > 3 && strcmp(argv[3], "factory") == 0; // Captive portal DNS gets 4 queries per request
+
+  runDelayLoop(seconds, rate, factory);
+  runScheduled(seconds, rate, factory);
+  return 0;
+}
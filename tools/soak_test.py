@@ -0,0 +1,108 @@
+"""Hammer a device's HTTP endpoints and check that the heap stays flat.
+
+Usage: python tools/soak_test.py <device-ip> [--minutes N] [--tolerance BYTES]
+
+Runs against a device in monitoring mode. After a warm-up round it records
+free heap and the largest free block from /metrics, then cycles through the
+status, page and effect endpoints for the given time. It exits non-zero if
+either value ends up more than the tolerance below the baseline, or if the
+settings store wrote to flash more often than its quiet period allows.
+"""
+
+import argparse
+import sys
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+GET_PATHS = ["/", "/status", "/probes", "/strips", "/metrics", "/style.css", "/effects.js"]
+EFFECT_POSTS = [
+    {"effect": "static", "color": "#123456"},
+    {"effect": "snake", "snakeColor": "#FF8800"},
+    {"effect": "rainbow", "fps": "30"},
+    {"effect": "no_such_effect"},  # Error paths format their replies too
+    {"effect": "static", "color": "bad"},
+]
+SETTINGS_QUIET_PERIOD = 5  # Seconds, see src/settings.h
+
+
+def request(base, path, form=None):
+    data = urllib.parse.urlencode(form).encode() if form is not None else None
+    try:
+        with urllib.request.urlopen(base + path, data=data, timeout=5) as response:
+            return response.read().decode(errors="replace")
+    except urllib.error.HTTPError as error:
+        return error.read().decode(errors="replace")
+
+
+def metrics(base):
+    values = {}
+    for line in request(base, "/metrics").splitlines():
+        if line and not line.startswith("#") and "{" not in line:
+            name, value = line.split()
+            values[name] = float(value)
+    return values
+
+
+def heap(base):
+    values = metrics(base)
+    return int(values["wifimon_heap_free_bytes"]), int(values["wifimon_heap_largest_block_bytes"])
+
+
+def flash_writes(base):
+    return int(metrics(base)["wifimon_settings_flash_writes_total"])
+
+
+def one_round(base):
+    for path in GET_PATHS:
+        request(base, path)
+    for form in EFFECT_POSTS:
+        request(base, "/effect", form)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--minutes", type=float, default=10)
+    parser.add_argument("--tolerance", type=int, default=2048, help="allowed drop in bytes")
+    args = parser.parse_args()
+    base = "http://" + args.host
+
+    one_round(base)  # Lets lazily allocated buffers settle before the baseline
+    base_free, base_block = heap(base)
+    base_writes = flash_writes(base)
+    print(f"baseline: free {base_free}, largest block {base_block}, settings writes {base_writes}")
+
+    rounds = 0
+    start = time.time()
+    end = start + args.minutes * 60
+    while time.time() < end:
+        one_round(base)
+        rounds += 1
+        if rounds % 50 == 0:
+            free, block = heap(base)
+            print(f"round {rounds}: free {free}, largest block {block}")
+
+    request(base, "/effect", {"effect": "breathe_green"})
+    time.sleep(SETTINGS_QUIET_PERIOD + 1)  # Let the last change reach flash
+    free, block = heap(base)
+    writes = flash_writes(base) - base_writes
+    allowed = int((time.time() - start) / SETTINGS_QUIET_PERIOD) + 1
+    print(f"final after {rounds} rounds: free {free}, largest block {block}, settings writes {writes}")
+
+    failed = False
+    if free < base_free - args.tolerance:
+        print(f"FAIL: free heap dropped by {base_free - free} bytes")
+        failed = True
+    if block < base_block - args.tolerance:
+        print(f"FAIL: largest free block shrank by {base_block - block} bytes")
+        failed = True
+    if writes > allowed:
+        print(f"FAIL: {writes} settings writes, at most {allowed} expected")
+        failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,40 @@
+// Changes are sent as JSON batches to /command. Only one request is in
+// flight at a time; whatever changes while it runs is merged and sent next,
+// so dragging a picker or slider costs one round trip per response.
+let pendingCommand = null;
+let commandInFlight = false;
+function sendCommand(changes) {
+  pendingCommand = Object.assign(pendingCommand || {}, changes);
+  if(commandInFlight) return;
+  const body = JSON.stringify(pendingCommand);
+  pendingCommand = null;
+  commandInFlight = true;
+  fetch('/command', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/json'},
+    body: body
+  }).finally(() => {
+    commandInFlight = false;
+    if(pendingCommand) sendCommand({});
+  });
+}
+function setEffect(effect) {
+  document.getElementById('colorPicker').style.display = 'none';
+  document.getElementById('snakeColorPicker').style.display = 'none';
+  if(effect === 'static') {
+    document.getElementById('colorPicker').style.display = 'block';
+  } else if(effect === 'snake') {
+    document.getElementById('snakeColorPicker').style.display = 'block';
+  }
+  sendCommand({
+    effect: effect,
+    color: document.getElementById('staticColor').value,
+    snakeColor: document.getElementById('snakeColor').value
+  });
+}
+function updateStaticColor() {
+  sendCommand({effect: 'static', color: document.getElementById('staticColor').value});
+}
+function updateSnakeColor() {
+  sendCommand({effect: 'snake', snakeColor: document.getElementById('snakeColor').value});
+}
@@ -0,0 +1,30 @@
+function returnToMonitoring() {
+  fetch('/monitoring', {method: 'POST'}).then(() => {
+    alert('Returned to monitoring mode');
+  });
+}
+function factoryReset() {
+  if(confirm('Are you sure you want to reset to factory settings?')) {
+    fetch('/reset', {method: 'POST'}).then(() => {
+      alert('Device will restart in factory mode');
+      setTimeout(() => location.reload(), 3000);
+    });
+  }
+}
+function setStatus(id, ok, text) {
+  const el = document.getElementById(id);
+  el.className = 'value ' + (ok ? 'connected' : 'disconnected');
+  el.textContent = text;
+}
+function subscribeStatus() {
+  const events = new EventSource(`http://${location.hostname}:81/`);
+  events.onmessage = (e) => {
+    const s = JSON.parse(e.data);
+    setStatus('wifi', s.wifi_connected, s.wifi_connected ? 'Connected' : 'Disconnected');
+    setStatus('internet', s.internet, s.internet_state === 'degraded' ? 'Degraded' : s.internet ? 'Available' : 'Not Available');
+    document.getElementById('rssi').textContent = `${s.rssi} dBm`;
+    document.getElementById('latency').textContent = `${s.latency_ms} ms`;
+    document.getElementById('effect').textContent = s.effect;
+  };
+}
+subscribeStatus();
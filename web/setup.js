@@ -0,0 +1,54 @@
+function scanNetworks() {
+  fetch('/scan').then(r => r.json()).then(data => {
+    const list = document.getElementById('networks');
+    list.innerHTML = '';
+    if(data.networks.length === 0) {
+      list.textContent = data.scanning ? 'Scanning...' : 'No networks found';
+    }
+    const box = document.createElement('div');
+    box.className = 'networks';
+    data.networks.sort((a, b) => b.rssi - a.rssi).forEach(n => {
+      const item = document.createElement('div');
+      item.className = 'network-item';
+      item.onclick = () => selectNetwork(n.ssid);
+      const name = document.createElement('strong');
+      name.textContent = n.ssid;
+      item.append(name, ` (${n.rssi} dBm)${n.secure ? ' \u{1F512}' : ''}`);
+      box.appendChild(item);
+    });
+    list.appendChild(box);
+    // The device answers from its cache and rescans in the background
+    if(data.scanning) setTimeout(scanNetworks, 1500);
+  });
+}
+function selectNetwork(ssid) {
+  document.getElementById('ssid').value = ssid;
+}
+function connectToWiFi(e) {
+  e.preventDefault();
+  const ssid = document.getElementById('ssid').value;
+  const password = document.getElementById('password').value;
+  fetch('/connect', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: `ssid=${encodeURIComponent(ssid)}&password=${encodeURIComponent(password)}`
+  }).then(r => {
+    if(r.status === 202) {
+      pollConnectStatus(ssid);
+    } else {
+      r.text().then(alert);
+    }
+  });
+}
+function pollConnectStatus(ssid) {
+  fetch('/connect/status').then(r => r.json()).then(s => {
+    if(s.state === 'connecting') {
+      setTimeout(() => pollConnectStatus(ssid), 1000);
+    } else if(s.state === 'connected') {
+      alert(`Success! Connected to ${ssid}. Device will restart in monitoring mode.`);
+    } else {
+      alert(`Failed to connect to ${ssid}. Please check credentials.`);
+    }
+  }).catch(() => setTimeout(() => pollConnectStatus(ssid), 1000));
+}
+scanNetworks();